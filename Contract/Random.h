@@ -3,13 +3,108 @@ using namespace QPI;
 // Random contract: collects entropy reveals (commit-reveal), maintains an entropy pool,
 // lets buyers purchase bytes of entropy, and pays miners/shareholders.
 
+// Capacity profiles: sizes of the state arrays; the RANDOM_Capacity alias below selects the one
+// the contract is built with. All of them are used as Array lengths and as "& (LEN - 1)" masks,
+// so each must be a power of two.
+struct RANDOM_CapacityMainnet
+{
+	static constexpr uint32_t maxRecentMiners = 8192;  // 2^13
+	static constexpr uint32_t maxCommitments = 16384;  // 2^14
+	static constexpr uint32_t entropyHistoryLen = 64;  // 2^6
+	static constexpr uint32_t randomBytesLen = 32;     // 2^5
+	static constexpr uint32_t maxPrepaidBuyers = 1024; // 2^10
+};
+
+// Small footprint for test nets
+struct RANDOM_CapacityTestnet
+{
+	static constexpr uint32_t maxRecentMiners = 64;
+	static constexpr uint32_t maxCommitments = 128;
+	static constexpr uint32_t entropyHistoryLen = 16;
+	static constexpr uint32_t randomBytesLen = 32;
+	static constexpr uint32_t maxPrepaidBuyers = 128;
+};
+
+// Busy epochs with many parallel mining flows
+struct RANDOM_CapacityLarge
+{
+	static constexpr uint32_t maxRecentMiners = 16384;
+	static constexpr uint32_t maxCommitments = 32768;
+	static constexpr uint32_t entropyHistoryLen = 256;
+	static constexpr uint32_t randomBytesLen = 32;
+	static constexpr uint32_t maxPrepaidBuyers = 4096;
+};
+
+using RANDOM_Capacity = RANDOM_CapacityMainnet;
+
 // Key sizes and limits:
-constexpr uint32_t RANDOM_MAX_RECENT_MINERS = 512;   // 2^9
-constexpr uint32_t RANDOM_MAX_COMMITMENTS = 1024;    // 2^10
-constexpr uint32_t RANDOM_ENTROPY_HISTORY_LEN = 4;   // 2^2, even if 3 would suffice
-constexpr uint32_t RANDOM_VALID_DEPOSIT_AMOUNTS = 16;
+constexpr uint32_t RANDOM_MAX_RECENT_MINERS = RANDOM_Capacity::maxRecentMiners;
+constexpr uint32_t RANDOM_MAX_COMMITMENTS = RANDOM_Capacity::maxCommitments;
+constexpr uint32_t RANDOM_ENTROPY_HISTORY_LEN = RANDOM_Capacity::entropyHistoryLen; // pool version v lives in slot v & (LEN - 1)
+constexpr uint64_t RANDOM_BUY_VERSION_LAG = 2;       // buyers get at most the previous-but-one pool version
+constexpr uint32_t RANDOM_VALID_DEPOSIT_AMOUNTS = 16;   // deposit tiers 0..15, tier t is a deposit of 10^t QU
 constexpr uint32_t RANDOM_MAX_USER_COMMITMENTS = 32;
-constexpr uint32_t RANDOM_RANDOMBYTES_LEN = 32;
+constexpr uint32_t RANDOM_SNAPSHOT_PAGE_LEN = 64;      // 2^6, entries per GetCommitmentsPage/GetRecentMinersPage call
+constexpr uint32_t RANDOM_EVENT_RING_LEN = 1024;       // 2^10, event with sequence number s lives in slot s & (LEN - 1)
+constexpr uint32_t RANDOM_EVENT_PAGE_LEN = 64;         // 2^6, events per GetEventsSince call
+constexpr uint32_t RANDOM_MAX_BATCH_FLOWS = 8;         // 2^3, (seed, digest) pairs per RevealAndCommitBatch
+constexpr uint32_t RANDOM_RANDOMBYTES_LEN = RANDOM_Capacity::randomBytesLen;
+constexpr uint32_t RANDOM_MAX_PREPAID_BUYERS = RANDOM_Capacity::maxPrepaidBuyers;
+constexpr uint32_t RANDOM_BULK_RANDOMBYTES_LEN = 4096; // 2^12, BuyEntropyBulk maximum
+constexpr uint32_t RANDOM_EXPIRY_WHEEL_LEN = 16;     // 2^4, must exceed revealTimeoutTicks
+constexpr uint32_t RANDOM_INVALID_SLOT = 0xFFFFFFFF; // "no slot" marker for intrusive links
+constexpr uint64_t RANDOM_BULK_EXPANSION_DOMAIN = 0x31424D4F444E4152ULL; // "RANDOMB1", separates bulk stream hashes
+constexpr uint64_t RANDOM_REWARD_SCALE = 1000000;      // fixed-point scale of rewardPerWeight
+constexpr uint64_t RANDOM_MAX_ACCRUAL_PER_WEIGHT = 18446744073708ULL; // whole QU per weight one buy may add to rewardPerWeight
+static_assert(RANDOM_MAX_ACCRUAL_PER_WEIGHT < 0xFFFFFFFFFFFFFFFFULL / RANDOM_REWARD_SCALE,
+	"one capped accrual (quotient * SCALE plus the sub-QU part, below SCALE + 1) must fit in uint64");
+constexpr uint32_t RANDOM_REWARD_GENERATIONS = 64;     // 2^6, closed epochs whose final rewardPerWeight is kept
+constexpr uint32_t RANDOM_STALE_SETTLE_PER_EPOCH = 128;   // recent miner slots settled per epoch, one ring pass per generation cycle
+static_assert(RANDOM_STALE_SETTLE_PER_EPOCH * RANDOM_REWARD_GENERATIONS == RANDOM_MAX_RECENT_MINERS,
+	"RANDOM_STALE_SETTLE_PER_EPOCH must be maxRecentMiners / RANDOM_REWARD_GENERATIONS for the selected profile");
+
+// Deposit tiers: a valid deposit is 10^t QU, stored as the uint8 tier t
+struct RANDOM_DepositTiers
+{
+	static constexpr uint64_t amount(uint32_t tier) { return tier == 0 ? 1ULL : 10ULL * amount(tier - 1); }
+
+	// Highest tier whose amount is <= value (0 below 1 QU): a sum of comparisons against compile-time
+	// constants, unrolled by the template, so the lookup has no loop and no data-dependent branch
+	template <uint32_t Tier = 1>
+	static constexpr uint32_t floorTier(uint64_t value)
+	{
+		if constexpr (Tier >= RANDOM_VALID_DEPOSIT_AMOUNTS)
+		{
+			return 0;
+		}
+		else
+		{
+			return uint32_t(value >= amount(Tier)) + floorTier<Tier + 1>(value);
+		}
+	}
+};
+static_assert(RANDOM_DepositTiers::amount(RANDOM_VALID_DEPOSIT_AMOUNTS - 1) == 1000000000000000ULL, "deposit tiers must fit in uint64");
+static_assert(RANDOM_DepositTiers::floorTier(999) == 2 && RANDOM_DepositTiers::floorTier(1000) == 3, "floorTier is off");
+
+// Compile-time validation of a capacity profile (instantiated for the selected one below)
+template <typename Capacity>
+struct RANDOM_CapacityChecks
+{
+	static constexpr bool isPowerOfTwo(uint32_t v) { return v && !(v & (v - 1)); }
+
+	static_assert(isPowerOfTwo(Capacity::maxRecentMiners), "maxRecentMiners must be a power of two");
+	static_assert(isPowerOfTwo(Capacity::maxCommitments), "maxCommitments must be a power of two");
+	static_assert(isPowerOfTwo(Capacity::entropyHistoryLen), "entropyHistoryLen must be a power of two");
+	static_assert(isPowerOfTwo(Capacity::randomBytesLen), "randomBytesLen must be a power of two");
+	static_assert(isPowerOfTwo(Capacity::maxPrepaidBuyers), "maxPrepaidBuyers must be a power of two");
+	static_assert(Capacity::entropyHistoryLen > RANDOM_BUY_VERSION_LAG, "entropyHistoryLen must hold the buy version lag");
+	static_assert(Capacity::maxRecentMiners >= RANDOM_REWARD_GENERATIONS, "maxRecentMiners must cover one settlement slot per reward generation");
+	static_assert(Capacity::maxCommitments < RANDOM_INVALID_SLOT, "commitment slots must not collide with RANDOM_INVALID_SLOT");
+	static_assert(Capacity::randomBytesLen <= 32, "BuyEntropy serves at most one 256-bit pool");
+	static constexpr bool ok = true;
+};
+
+static_assert(RANDOM_CapacityChecks<RANDOM_Capacity>::ok, "invalid RANDOM capacity profile");
 
 struct RANDOM2 {};
 
@@ -17,20 +112,75 @@ struct RANDOM2 {};
 struct RANDOM_RecentMiner
 {
 	id     minerId;
-	uint64 deposit;
 	uint64 lastEntropyVersion;
 	uint32 lastRevealTick;
+	uint32 generation;            // epoch generation the entry belongs to
+
+	// Pull-based earnings: weight is depositTier + 1, pending reward is
+	// weight * (rewardPerWeight - rewardCheckpoint) / RANDOM_REWARD_SCALE on top of earnings.
+	uint64 rewardCheckpoint;
+	uint64 earnings;              // settled but not yet paid
+	uint8  depositTier;           // deposit is 10^depositTier QU
+};
+
+// Freshest reveal at or above one deposit tier (used for O(1) BuyEntropy eligibility)
+struct RANDOM_TierFreshness
+{
+	uint64 revealerDeposit;       // deposit of the miner behind lastRevealTick
+	uint32 lastRevealTick;
+	bool   hasReveal;
 };
 
-// Stored commitment created by miners (commit-reveal scheme)
-struct RANDOM_EntropyCommitment
+// One commitment as returned by GetCommitmentsPage
+struct RANDOM_CommitmentRecord
 {
-	id     digest;                // K12(revealedBits) stored at commit time
-	id     invocatorId;           // who committed
-	uint64 amount;                // security deposit
+	id     digest;
+	id     invocatorId;
+	uint64 amount;
 	uint32 commitTick;
 	uint32 revealDeadlineTick;
-	bool   hasRevealed;
+};
+
+// Event types of RANDOM_Event
+constexpr uint8_t RANDOM_EVENT_REVEAL = 1;             // subject revealed in time, amount = returned deposit
+constexpr uint8_t RANDOM_EVENT_FORFEIT = 2;            // deposit of subject lost (late reveal or expired), amount = deposit
+constexpr uint8_t RANDOM_EVENT_EMPTY_TICK_REFUND = 3;  // deadline tick was empty, amount = refunded deposit
+constexpr uint8_t RANDOM_EVENT_PURCHASE = 4;           // subject bought entropy, amount = fee paid
+constexpr uint8_t RANDOM_EVENT_EVICTION = 5;           // subject was displaced from recentMiners, amount = its deposit
+
+// One entry of the event ring (read with GetEventsSince)
+struct RANDOM_Event
+{
+	id     subject;               // miner or buyer the event is about
+	uint64 seq;                   // 0, 1, 2, ... without gaps
+	uint64 amount;
+	uint32 tick;
+	uint8  type;                  // RANDOM_EVENT_*
+};
+
+// Work counters of the hot loops, cumulative since INITIALIZE (exposed by GetPerfCounters)
+struct RANDOM_PerfCounters
+{
+	uint64 sweepCalls;                  // sweeps that visited at least one wheel bucket
+	uint64 sweepEntriesScanned;         // commitments visited by expiry sweeps and empty-tick refunds
+	uint64 maxSweepEntriesScanned;      // largest single expiry sweep
+	uint64 revealMatchIterations;       // owner-list commitments compared against a revealed digest
+	uint64 revealDigestsComputed;       // reveals that hashed the preimage (only done when the owner has a pending commitment)
+	uint64 recentMinerLookups;          // recentMinerSlots index searches
+	uint64 recentMinerSiftSteps;        // heap levels moved while ordering recentMiners for eviction
+	uint64 recentMinerEvictions;        // heap minimum replaced by a higher-ranked miner
+	uint64 refundsIssued;               // transfers returning an invocation reward or an empty-tick deposit
+	uint64 commitsRejectedByCapacity;   // new commitments refused because storage was full
+};
+
+// K12 input for one 32-byte block of a BuyEntropyBulk stream (counter-mode expansion)
+struct RANDOM_BulkExpansionBlock
+{
+	m256i  pool;
+	id     buyerId;
+	uint64 domain;
+	uint32 tick;
+	uint32 blockIndex;
 };
 
 // Contract state and logic
@@ -39,19 +189,34 @@ struct RANDOM : public ContractBase
 private:
 	// --- QPI contract state ---
 	
-	// Circular history of recent entropy pools (m256i)
+	// Circular history of recent entropy pools (m256i), addressed by pool version:
+	// version v is stored in slot v & (RANDOM_ENTROPY_HISTORY_LEN - 1) while it is in range.
+	// One version is committed per tick with reveals (at END_TICK), so versions count ticks.
 	Array<m256i, RANDOM_ENTROPY_HISTORY_LEN> entropyHistory;
 	Array<uint64, RANDOM_ENTROPY_HISTORY_LEN> entropyPoolVersionHistory;
-	uint32 entropyHistoryHead;
+	Array<uint32, RANDOM_ENTROPY_HISTORY_LEN> entropyHistoryTick;
 
-	// current 256-bit entropy pool and its version
+	// current 256-bit entropy pool and its version; reveals of the running tick are XORed into
+	// currentEntropyPool and become version entropyPoolVersion + 1 at END_TICK
 	m256i currentEntropyPool;
 	uint64 entropyPoolVersion;
+	uint32 pendingRevealCount;           // reveals accumulated in the running tick
 
 	// Metrics and bookkeeping
 	uint64 totalCommits;
 	uint64 totalReveals;
 	uint64 totalSecurityDepositsLocked;
+	uint64 totalForfeitedCommitments;    // swept after the deadline or revealed too late
+	uint64 totalRefundedCommitments;     // refunded because their deadline tick was empty
+	RANDOM_PerfCounters perf;
+
+	// Bumped by every change to the stored commitments or recentMiners entries, so that a paged
+	// snapshot (GetCommitmentsPage/GetRecentMinersPage) can detect that it straddled a mutation
+	uint64 stateVersion;
+
+	// Event ring for incremental off-chain sync: the last RANDOM_EVENT_RING_LEN events, eventCount in total
+	Array<RANDOM_Event, RANDOM_EVENT_RING_LEN> events;
+	uint64 eventCount;
 
 	// Configurable parameters
 	uint64 minimumSecurityDeposit;
@@ -68,40 +233,975 @@ private:
 	uint64 pricePerByte;
 	uint64 priceDepositDivisor;
 
-	// Recent miners (LRU-like), used to split miner earnings
+	// Recent miners (LRU-like), used to split miner earnings. Entries keep their slot; a binary
+	// min-heap of slots ordered by (deposit, lastEntropyVersion) finds the eviction candidate.
 	Array<RANDOM_RecentMiner, RANDOM_MAX_RECENT_MINERS> recentMiners;
 	uint32 recentMinerCount;
-
-	// Allowed deposit amounts (valid security deposits)
+	Array<uint32, RANDOM_MAX_RECENT_MINERS> recentMinerHeap;     // heap position -> slot
+	Array<uint32, RANDOM_MAX_RECENT_MINERS> recentMinerHeapPos;  // slot -> heap position
+	HashMap<id, uint32, RANDOM_MAX_RECENT_MINERS * 2> recentMinerSlots; // miner id -> slot
+
+	// Miner rewards: buyer fees accrue to rewardPerWeight (O(1) per buy) and are paid on ClaimEarnings.
+	// Entries of earlier generations (epochs) are stale: they no longer earn and are settled against the
+	// rewardPerWeight their generation closed with. Slots at or above recentMinerCount are stale or empty.
+	uint64 rewardPerWeight;
+	uint64 rewardRemainder;              // scaled remainder carried to the next accrual (also across epochs)
+	uint64 unassignedMinerReward;        // accrued while no miner held weight
+	uint64 totalMinerWeight;
+	uint32 recentMinerGeneration;
+	uint32 staleSettleCursor;
+	Array<uint64, RANDOM_REWARD_GENERATIONS> generationClosingReward;
+
+	// Allowed deposit amounts (valid security deposits), validDepositAmounts[t] = 10^t for deposit tier t
 	Array<uint64, RANDOM_VALID_DEPOSIT_AMOUNTS> validDepositAmounts;
 
-	// Active commitments (commitments array + count)
-	Array<RANDOM_EntropyCommitment, RANDOM_MAX_COMMITMENTS> commitments;
-	uint32 commitmentCount;
+	// Per deposit tier t: latest reveal by a miner whose deposit >= validDepositAmounts[t]
+	Array<RANDOM_TierFreshness, RANDOM_VALID_DEPOSIT_AMOUNTS> freshestRevealAtTier;
+
+	// Active commitments, stored as parallel arrays indexed by slot (0 .. commitmentCount - 1) so that
+	// the sweep reads only deadlines and links and the reveal match only digests. Commitments are
+	// removed as soon as they are opened, forfeited or refunded, so every stored one is unrevealed.
+	Array<id, RANDOM_MAX_COMMITMENTS> commitmentDigests;       // K12(revealedBits) stored at commit time
+	Array<id, RANDOM_MAX_COMMITMENTS> commitmentInvocators;    // who committed
+	Array<uint8, RANDOM_MAX_COMMITMENTS> commitmentDepositTiers; // security deposit is 10^tier QU
+	Array<uint32, RANDOM_MAX_COMMITMENTS> commitmentCommitTicks;
+	Array<uint32, RANDOM_MAX_COMMITMENTS> commitmentDeadlines; // reveal deadline tick
+	uint32 commitmentCount;
+
+	// Intrusive links of the expiry-wheel bucket and of the owner's list each commitment belongs to
+	Array<uint32, RANDOM_MAX_COMMITMENTS> commitmentExpiryNext;
+	Array<uint32, RANDOM_MAX_COMMITMENTS> commitmentExpiryPrev;
+	Array<uint32, RANDOM_MAX_COMMITMENTS> commitmentOwnerNext;
+	Array<uint32, RANDOM_MAX_COMMITMENTS> commitmentOwnerPrev;
+
+	// Expiry wheel: commitments bucketed by revealDeadlineTick & (RANDOM_EXPIRY_WHEEL_LEN - 1).
+	// Buckets of ticks before expiryWheelTick have already been swept.
+	Array<uint32, RANDOM_EXPIRY_WHEEL_LEN> expiryWheelHeads;
+	uint32 expiryWheelTick;
+
+	// Owner index: miner id -> first slot of its commitment list (linked through commitmentOwnerNext/Prev)
+	HashMap<id, uint32, RANDOM_MAX_COMMITMENTS * 2> commitmentOwners;
+
+	// Prepaid buyer balances: buyer id -> QU held for BuyEntropy/BuyEntropyBulk with usePrepaid set.
+	// Entries are removed when their balance reaches zero; totalPrepaidBalance is their sum. At most
+	// RANDOM_MAX_PREPAID_BUYERS entries are admitted so the map stays at most half full.
+	HashMap<id, uint64, RANDOM_MAX_PREPAID_BUYERS * 2> prepaidBalances;
+	uint64 totalPrepaidBalance;
+
+	// --- QPI-compliant helpers ---
+	
+	// Simple helpers that avoid forbidden constructs in contracts.
+
+	// A deposit is valid iff it equals the amount of its floor tier (O(1), no scan of validDepositAmounts)
+	static inline bool isValidDeposit(const RANDOM& state, uint64 amount)
+	{
+		return amount == state.validDepositAmounts.get(RANDOM_DepositTiers::floorTier(amount));
+	}
+
+	static inline uint64 commitmentDeposit(const RANDOM& state, uint32 slot)
+	{
+		return state.validDepositAmounts.get(state.commitmentDepositTiers.get(slot));
+	}
+
+	static inline uint64 recentMinerWeight(const RANDOM_RecentMiner& miner)
+	{
+		return miner.depositTier + 1ULL;
+	}
+
+	static inline bool isEqualIdCheck(const id& a, const id& b)
+	{
+		return a == b;
+	}
+
+	static inline bool isZeroIdCheck(const id& value)
+	{
+		return isZero(value);
+	}
+
+	// Eviction order of recent miners: lower deposit tier first, then older entropy version
+	static inline bool recentMinerRanksLower(const RANDOM_RecentMiner& a, const RANDOM_RecentMiner& b)
+	{
+		return a.depositTier < b.depositTier || (a.depositTier == b.depositTier && a.lastEntropyVersion < b.lastEntropyVersion);
+	}
+	
+	// Unpaid reward of a recent miner entry (settled earnings plus accrual since its checkpoint)
+	static inline uint64 recentMinerPendingReward(const RANDOM& state, const RANDOM_RecentMiner& miner)
+	{
+		return miner.earnings + recentMinerAccrual(miner, (miner.generation == state.recentMinerGeneration)
+			? state.rewardPerWeight : state.generationClosingReward.get(miner.generation & (RANDOM_REWARD_GENERATIONS - 1)));
+	}
+
+	static inline uint64 recentMinerAccrual(const RANDOM_RecentMiner& miner, uint64 rewardPerWeight)
+	{
+		// floor(weight * delta / SCALE) without overflowing the product
+		return recentMinerWeight(miner) * div(rewardPerWeight - miner.rewardCheckpoint, (uint64)RANDOM_REWARD_SCALE) +
+			div(recentMinerWeight(miner) * mod(rewardPerWeight - miner.rewardCheckpoint, (uint64)RANDOM_REWARD_SCALE), (uint64)RANDOM_REWARD_SCALE);
+	}
+
+	static inline uint64 calculatePrice(const RANDOM& state, uint32 numberOfBytes, uint64 minMinerDeposit)
+	{
+	    return state.pricePerByte * numberOfBytes *
+	        (div(minMinerDeposit, state.priceDepositDivisor) + 1ULL);
+	}
+
+	// --- Internal procedures (event ring) ---
+
+	struct RecordEvent_input
+	{
+		id     subject;
+		uint64 amount;
+		uint8  type;
+	};
+	struct RecordEvent_output {};
+	struct RecordEvent_locals
+	{
+		RANDOM_Event event;
+	};
+
+	// RecordEvent: append one event to the ring, overwriting the oldest one when it is full
+	PRIVATE_PROCEDURE_WITH_LOCALS(RecordEvent)
+	{
+		locals.event.subject = input.subject;
+		locals.event.seq = state.eventCount;
+		locals.event.amount = input.amount;
+		locals.event.tick = qpi.tick();
+		locals.event.type = input.type;
+		state.events.set(state.eventCount & (RANDOM_EVENT_RING_LEN - 1), locals.event);
+		state.eventCount++;
+	}
+
+	// --- Internal procedures (commitment storage and expiry wheel) ---
+
+	struct AddCommitment_input
+	{
+		id     digest;
+		id     invocatorId;
+		uint8  depositTier;
+	};
+	struct AddCommitment_output
+	{
+		bool success;
+	};
+	struct AddCommitment_locals
+	{
+		uint32 slot;
+		uint32 deadline;
+		uint32 bucket;
+		uint32 head;
+		sint64 ownerIx;
+	};
+
+	struct RemoveCommitment_input
+	{
+		uint32 slot;
+	};
+	struct RemoveCommitment_output {};
+	struct RemoveCommitment_locals
+	{
+		uint32 lastSlot;
+		uint32 ownerNext;
+		uint32 ownerPrev;
+		uint32 expiryNext;
+		uint32 expiryPrev;
+	};
+
+	struct SweepExpiredCommitments_input {};
+	struct SweepExpiredCommitments_output {};
+	struct SweepExpiredCommitments_locals
+	{
+		uint32 currentTick;
+		uint32 sweepTick;
+		uint32 slot;
+		uint32 nextSlot;
+		uint64 lostDeposit;
+		uint64 scanned;
+		RemoveCommitment_input removeInput;
+		RemoveCommitment_output removeOutput;
+		RecordEvent_input eventInput;
+		RecordEvent_output eventOutput;
+	};
+
+	struct RefundEmptyTickCommitments_input {};
+	struct RefundEmptyTickCommitments_output {};
+	struct RefundEmptyTickCommitments_locals
+	{
+		uint32 currentTick;
+		uint32 slot;
+		uint32 nextSlot;
+		RemoveCommitment_input removeInput;
+		RemoveCommitment_output removeOutput;
+		RecordEvent_input eventInput;
+		RecordEvent_output eventOutput;
+	};
+
+	// AddCommitment: append a commitment and push it onto the wheel bucket of its deadline
+	PRIVATE_PROCEDURE_WITH_LOCALS(AddCommitment)
+	{
+		output.success = false;
+		if (state.commitmentCount >= RANDOM_MAX_COMMITMENTS)
+		{
+			state.perf.commitsRejectedByCapacity++;
+			return;
+		}
+
+		// Push onto the owner's list
+		locals.slot = state.commitmentCount;
+		locals.ownerIx = state.commitmentOwners.getElementIndex(input.invocatorId);
+		locals.head = (locals.ownerIx < 0) ? RANDOM_INVALID_SLOT : state.commitmentOwners.value(locals.ownerIx);
+		if (state.commitmentOwners.set(input.invocatorId, locals.slot) < 0)
+		{
+			state.perf.commitsRejectedByCapacity++;
+			return;
+		}
+		state.commitmentOwnerNext.set(locals.slot, locals.head);
+		state.commitmentOwnerPrev.set(locals.slot, RANDOM_INVALID_SLOT);
+		if (locals.head != RANDOM_INVALID_SLOT)
+		{
+			state.commitmentOwnerPrev.set(locals.head, locals.slot);
+		}
+
+		locals.deadline = qpi.tick() + state.revealTimeoutTicks;
+		state.commitmentDigests.set(locals.slot, input.digest);
+		state.commitmentInvocators.set(locals.slot, input.invocatorId);
+		state.commitmentDepositTiers.set(locals.slot, input.depositTier);
+		state.commitmentCommitTicks.set(locals.slot, qpi.tick());
+		state.commitmentDeadlines.set(locals.slot, locals.deadline);
+
+		// Push onto the wheel bucket of the deadline
+		locals.bucket = locals.deadline & (RANDOM_EXPIRY_WHEEL_LEN - 1);
+		locals.head = state.expiryWheelHeads.get(locals.bucket);
+		state.commitmentExpiryNext.set(locals.slot, locals.head);
+		state.commitmentExpiryPrev.set(locals.slot, RANDOM_INVALID_SLOT);
+		if (locals.head != RANDOM_INVALID_SLOT)
+		{
+			state.commitmentExpiryPrev.set(locals.head, locals.slot);
+		}
+		state.expiryWheelHeads.set(locals.bucket, locals.slot);
+
+		state.commitmentCount++;
+		state.totalCommits++;
+		state.stateVersion++;
+		state.totalSecurityDepositsLocked += state.validDepositAmounts.get(input.depositTier);
+		output.success = true;
+	}
+
+	// RemoveCommitment: unlink a commitment from its wheel bucket and owner list and fill the hole
+	// with the last commitment (swap-with-last), re-pointing that commitment's neighbours at its new slot.
+	PRIVATE_PROCEDURE_WITH_LOCALS(RemoveCommitment)
+	{
+		locals.ownerNext = state.commitmentOwnerNext.get(input.slot);
+		locals.ownerPrev = state.commitmentOwnerPrev.get(input.slot);
+		locals.expiryNext = state.commitmentExpiryNext.get(input.slot);
+		locals.expiryPrev = state.commitmentExpiryPrev.get(input.slot);
+
+		// Unlink from the owner list; drop the owner from the index when its list becomes empty
+		if (locals.ownerPrev != RANDOM_INVALID_SLOT)
+		{
+			state.commitmentOwnerNext.set(locals.ownerPrev, locals.ownerNext);
+		}
+		else
+		{
+			if (locals.ownerNext != RANDOM_INVALID_SLOT)
+			{
+				state.commitmentOwners.set(state.commitmentInvocators.get(input.slot), locals.ownerNext);
+			}
+			else
+			{
+				state.commitmentOwners.removeByKey(state.commitmentInvocators.get(input.slot));
+			}
+		}
+		if (locals.ownerNext != RANDOM_INVALID_SLOT)
+		{
+			state.commitmentOwnerPrev.set(locals.ownerNext, locals.ownerPrev);
+		}
+
+		// Unlink from the expiry wheel
+		if (locals.expiryPrev != RANDOM_INVALID_SLOT)
+		{
+			state.commitmentExpiryNext.set(locals.expiryPrev, locals.expiryNext);
+		}
+		else
+		{
+			state.expiryWheelHeads.set(state.commitmentDeadlines.get(input.slot) & (RANDOM_EXPIRY_WHEEL_LEN - 1), locals.expiryNext);
+		}
+		if (locals.expiryNext != RANDOM_INVALID_SLOT)
+		{
+			state.commitmentExpiryPrev.set(locals.expiryNext, locals.expiryPrev);
+		}
+
+		locals.lastSlot = state.commitmentCount - 1;
+		if (input.slot != locals.lastSlot)
+		{
+			state.commitmentDigests.set(input.slot, state.commitmentDigests.get(locals.lastSlot));
+			state.commitmentInvocators.set(input.slot, state.commitmentInvocators.get(locals.lastSlot));
+			state.commitmentDepositTiers.set(input.slot, state.commitmentDepositTiers.get(locals.lastSlot));
+			state.commitmentCommitTicks.set(input.slot, state.commitmentCommitTicks.get(locals.lastSlot));
+			state.commitmentDeadlines.set(input.slot, state.commitmentDeadlines.get(locals.lastSlot));
+
+			locals.ownerNext = state.commitmentOwnerNext.get(locals.lastSlot);
+			locals.ownerPrev = state.commitmentOwnerPrev.get(locals.lastSlot);
+			locals.expiryNext = state.commitmentExpiryNext.get(locals.lastSlot);
+			locals.expiryPrev = state.commitmentExpiryPrev.get(locals.lastSlot);
+			state.commitmentOwnerNext.set(input.slot, locals.ownerNext);
+			state.commitmentOwnerPrev.set(input.slot, locals.ownerPrev);
+			state.commitmentExpiryNext.set(input.slot, locals.expiryNext);
+			state.commitmentExpiryPrev.set(input.slot, locals.expiryPrev);
+
+			if (locals.expiryPrev != RANDOM_INVALID_SLOT)
+			{
+				state.commitmentExpiryNext.set(locals.expiryPrev, input.slot);
+			}
+			else
+			{
+				state.expiryWheelHeads.set(state.commitmentDeadlines.get(input.slot) & (RANDOM_EXPIRY_WHEEL_LEN - 1), input.slot);
+			}
+			if (locals.expiryNext != RANDOM_INVALID_SLOT)
+			{
+				state.commitmentExpiryPrev.set(locals.expiryNext, input.slot);
+			}
+			if (locals.ownerPrev != RANDOM_INVALID_SLOT)
+			{
+				state.commitmentOwnerNext.set(locals.ownerPrev, input.slot);
+			}
+			else
+			{
+				state.commitmentOwners.set(state.commitmentInvocators.get(input.slot), input.slot);
+			}
+			if (locals.ownerNext != RANDOM_INVALID_SLOT)
+			{
+				state.commitmentOwnerPrev.set(locals.ownerNext, input.slot);
+			}
+		}
+		state.commitmentCount--;
+		state.stateVersion++;
+	}
+
+	// SweepExpiredCommitments: forfeit every unrevealed commitment whose deadline has passed.
+	// Only the wheel buckets of ticks elapsed since the previous sweep are visited, so the cost is
+	// proportional to the number of expiring commitments rather than to commitmentCount.
+	PRIVATE_PROCEDURE_WITH_LOCALS(SweepExpiredCommitments)
+	{
+		locals.currentTick = qpi.tick();
+		if (locals.currentTick <= state.expiryWheelTick)
+		{
+			return;
+		}
+
+		// After a gap longer than the wheel, every bucket is visited exactly once
+		locals.sweepTick = state.expiryWheelTick;
+		if (locals.currentTick - locals.sweepTick > RANDOM_EXPIRY_WHEEL_LEN)
+		{
+			locals.sweepTick = locals.currentTick - RANDOM_EXPIRY_WHEEL_LEN;
+		}
+
+		for (; locals.sweepTick < locals.currentTick; ++locals.sweepTick)
+		{
+			locals.slot = state.expiryWheelHeads.get(locals.sweepTick & (RANDOM_EXPIRY_WHEEL_LEN - 1));
+			while (locals.slot != RANDOM_INVALID_SLOT)
+			{
+				locals.scanned++;
+				locals.nextSlot = state.commitmentExpiryNext.get(locals.slot);
+				if (locals.currentTick > state.commitmentDeadlines.get(locals.slot))
+				{
+					// Move deposit into lost revenue and remove commitment
+					locals.lostDeposit = commitmentDeposit(state, locals.slot);
+					state.lostDepositsRevenue += locals.lostDeposit;
+					state.totalRevenue += locals.lostDeposit;
+					state.pendingShareholderDistribution += locals.lostDeposit;
+					state.totalSecurityDepositsLocked -= locals.lostDeposit;
+					state.totalForfeitedCommitments++;
+
+					locals.eventInput.subject = state.commitmentInvocators.get(locals.slot);
+					locals.eventInput.amount = locals.lostDeposit;
+					locals.eventInput.type = RANDOM_EVENT_FORFEIT;
+					CALL(RecordEvent, locals.eventInput, locals.eventOutput);
+
+					locals.removeInput.slot = locals.slot;
+					CALL(RemoveCommitment, locals.removeInput, locals.removeOutput);
+
+					// The last commitment was moved into the freed slot
+					if (locals.nextSlot == state.commitmentCount)
+					{
+						locals.nextSlot = locals.slot;
+					}
+				}
+				locals.slot = locals.nextSlot;
+			}
+		}
+		state.expiryWheelTick = locals.currentTick;
+
+		state.perf.sweepCalls++;
+		state.perf.sweepEntriesScanned += locals.scanned;
+		if (locals.scanned > state.perf.maxSweepEntriesScanned)
+		{
+			state.perf.maxSweepEntriesScanned = locals.scanned;
+		}
+	}
+
+	// RefundEmptyTickCommitments: on an empty tick, return deposits whose deadline is this tick
+	PRIVATE_PROCEDURE_WITH_LOCALS(RefundEmptyTickCommitments)
+	{
+		locals.currentTick = qpi.tick();
+		locals.slot = state.expiryWheelHeads.get(locals.currentTick & (RANDOM_EXPIRY_WHEEL_LEN - 1));
+		while (locals.slot != RANDOM_INVALID_SLOT)
+		{
+			state.perf.sweepEntriesScanned++;
+			locals.nextSlot = state.commitmentExpiryNext.get(locals.slot);
+			if (state.commitmentDeadlines.get(locals.slot) == locals.currentTick)
+			{
+				qpi.transfer(state.commitmentInvocators.get(locals.slot), commitmentDeposit(state, locals.slot));
+				state.perf.refundsIssued++;
+				state.totalSecurityDepositsLocked -= commitmentDeposit(state, locals.slot);
+				state.totalRefundedCommitments++;
+
+				locals.eventInput.subject = state.commitmentInvocators.get(locals.slot);
+				locals.eventInput.amount = commitmentDeposit(state, locals.slot);
+				locals.eventInput.type = RANDOM_EVENT_EMPTY_TICK_REFUND;
+				CALL(RecordEvent, locals.eventInput, locals.eventOutput);
+
+				locals.removeInput.slot = locals.slot;
+				CALL(RemoveCommitment, locals.removeInput, locals.removeOutput);
+				if (locals.nextSlot == state.commitmentCount)
+				{
+					locals.nextSlot = locals.slot;
+				}
+			}
+			locals.slot = locals.nextSlot;
+		}
+	}
+
+	// --- Internal procedures (recent miner heap) ---
+
+	struct SiftRecentMiner_input
+	{
+		uint32 heapPos;
+	};
+	struct SiftRecentMiner_output {};
+	struct SiftRecentMiner_locals
+	{
+		uint32 pos;
+		uint32 slot;
+		uint32 other;
+		uint32 otherSlot;
+		RANDOM_RecentMiner node;
+		RANDOM_RecentMiner candidate;
+	};
+
+	struct PayRecentMiner_input
+	{
+		uint32 slot;
+	};
+	struct PayRecentMiner_output
+	{
+		uint64 amount;
+	};
+	struct PayRecentMiner_locals
+	{
+		RANDOM_RecentMiner recentMiner;
+	};
+
+	struct RecordRecentMiner_input
+	{
+		id     minerId;
+		uint8  depositTier;
+	};
+	struct RecordRecentMiner_output {};
+	struct RecordRecentMiner_locals
+	{
+		sint64 existingIndex;
+		uint32 slot;
+		uint32 tier;
+		RANDOM_TierFreshness freshness;
+		RANDOM_RecentMiner recentMiner;
+		RANDOM_RecentMiner occupant;
+		SiftRecentMiner_input siftInput;
+		SiftRecentMiner_output siftOutput;
+		PayRecentMiner_input payInput;
+		PayRecentMiner_output payOutput;
+		RecordEvent_input eventInput;
+		RecordEvent_output eventOutput;
+	};
+
+	// SiftRecentMiner: restore heap order around a heap position whose key changed (O(log n))
+	PRIVATE_PROCEDURE_WITH_LOCALS(SiftRecentMiner)
+	{
+		locals.pos = input.heapPos;
+		locals.slot = state.recentMinerHeap.get(locals.pos);
+		locals.node = state.recentMiners.get(locals.slot);
+
+		// Move up while the parent ranks higher
+		while (locals.pos > 0)
+		{
+			locals.other = (locals.pos - 1) >> 1;
+			locals.otherSlot = state.recentMinerHeap.get(locals.other);
+			if (!recentMinerRanksLower(locals.node, state.recentMiners.get(locals.otherSlot)))
+			{
+				break;
+			}
+			state.recentMinerHeap.set(locals.pos, locals.otherSlot);
+			state.recentMinerHeapPos.set(locals.otherSlot, locals.pos);
+			locals.pos = locals.other;
+			state.perf.recentMinerSiftSteps++;
+		}
+
+		// Move down while the lower-ranked child ranks below the node
+		while (2 * locals.pos + 1 < state.recentMinerCount)
+		{
+			locals.other = 2 * locals.pos + 1;
+			locals.otherSlot = state.recentMinerHeap.get(locals.other);
+			locals.candidate = state.recentMiners.get(locals.otherSlot);
+			if (locals.other + 1 < state.recentMinerCount &&
+				recentMinerRanksLower(state.recentMiners.get(state.recentMinerHeap.get(locals.other + 1)), locals.candidate))
+			{
+				locals.other++;
+				locals.otherSlot = state.recentMinerHeap.get(locals.other);
+				locals.candidate = state.recentMiners.get(locals.otherSlot);
+			}
+			if (!recentMinerRanksLower(locals.candidate, locals.node))
+			{
+				break;
+			}
+			state.recentMinerHeap.set(locals.pos, locals.otherSlot);
+			state.recentMinerHeapPos.set(locals.otherSlot, locals.pos);
+			locals.pos = locals.other;
+			state.perf.recentMinerSiftSteps++;
+		}
+
+		state.recentMinerHeap.set(locals.pos, locals.slot);
+		state.recentMinerHeapPos.set(locals.slot, locals.pos);
+	}
+
+	// PayRecentMiner: transfer the unpaid reward of a recent miner entry and move its checkpoint
+	PRIVATE_PROCEDURE_WITH_LOCALS(PayRecentMiner)
+	{
+		locals.recentMiner = state.recentMiners.get(input.slot);
+		output.amount = recentMinerPendingReward(state, locals.recentMiner);
+		locals.recentMiner.rewardCheckpoint = (locals.recentMiner.generation == state.recentMinerGeneration)
+			? state.rewardPerWeight : state.generationClosingReward.get(locals.recentMiner.generation & (RANDOM_REWARD_GENERATIONS - 1));
+		locals.recentMiner.earnings = 0;
+		state.recentMiners.set(input.slot, locals.recentMiner);
+		state.stateVersion++;
+		if (output.amount > 0)
+		{
+			qpi.transfer(locals.recentMiner.minerId, output.amount);
+			state.minerEarningsPool -= output.amount;
+		}
+	}
+
+	// RecordRecentMiner: called for every successful reveal. Refreshes the per-tier freshness table,
+	// then maintains recentMiners LRU: update existing entry, append if space, or replace the heap
+	// minimum if the revealing miner ranks above it. Displaced and stale entries are paid out first.
+	PRIVATE_PROCEDURE_WITH_LOCALS(RecordRecentMiner)
+	{
+		state.stateVersion++;
+		locals.freshness.revealerDeposit = state.validDepositAmounts.get(input.depositTier);
+		locals.freshness.lastRevealTick = qpi.tick();
+		locals.freshness.hasReveal = true;
+		for (locals.tier = 0; locals.tier <= input.depositTier; ++locals.tier)
+		{
+			state.freshestRevealAtTier.set(locals.tier, locals.freshness);
+		}
+
+		locals.existingIndex = state.recentMinerSlots.getElementIndex(input.minerId);
+		state.perf.recentMinerLookups++;
+		if (locals.existingIndex >= 0 &&
+			state.recentMiners.get(state.recentMinerSlots.value(locals.existingIndex)).generation != state.recentMinerGeneration)
+		{
+			// Entry from an earlier epoch: pay it out, free the slot and re-enter as a new miner
+			locals.payInput.slot = state.recentMinerSlots.value(locals.existingIndex);
+			CALL(PayRecentMiner, locals.payInput, locals.payOutput);
+			setMemory(locals.occupant, 0);
+			state.recentMiners.set(locals.payInput.slot, locals.occupant);
+			state.recentMinerSlots.removeByIndex(locals.existingIndex);
+			locals.existingIndex = -1;
+		}
+		if (locals.existingIndex >= 0)
+		{
+			// update stored recent miner entry; its key can only rise, so sift it down
+			locals.slot = state.recentMinerSlots.value(locals.existingIndex);
+			locals.recentMiner = state.recentMiners.get(locals.slot);
+			locals.recentMiner.lastRevealTick = qpi.tick();
+			if (locals.recentMiner.depositTier < input.depositTier)
+			{
+				// settle at the old weight before switching to the new one
+				locals.recentMiner.earnings += recentMinerAccrual(locals.recentMiner, state.rewardPerWeight);
+				locals.recentMiner.rewardCheckpoint = state.rewardPerWeight;
+				state.totalMinerWeight += input.depositTier - locals.recentMiner.depositTier;
+				locals.recentMiner.depositTier = input.depositTier;
+				locals.recentMiner.lastEntropyVersion = state.entropyPoolVersion;
+				state.recentMiners.set(locals.slot, locals.recentMiner);
+				locals.siftInput.heapPos = state.recentMinerHeapPos.get(locals.slot);
+				CALL(SiftRecentMiner, locals.siftInput, locals.siftOutput);
+			}
+			else
+			{
+				state.recentMiners.set(locals.slot, locals.recentMiner);
+			}
+			return;
+		}
+
+		locals.recentMiner.minerId = input.minerId;
+		locals.recentMiner.depositTier = input.depositTier;
+		locals.recentMiner.lastEntropyVersion = state.entropyPoolVersion;
+		locals.recentMiner.lastRevealTick = qpi.tick();
+		locals.recentMiner.generation = state.recentMinerGeneration;
+		locals.recentMiner.rewardCheckpoint = state.rewardPerWeight;
+		locals.recentMiner.earnings = 0;
+
+		if (state.recentMinerCount < RANDOM_MAX_RECENT_MINERS)
+		{
+			// append new recent miner as a heap leaf, paying out a stale occupant of the slot
+			locals.slot = state.recentMinerCount;
+			locals.occupant = state.recentMiners.get(locals.slot);
+			if (!isZeroIdCheck(locals.occupant.minerId))
+			{
+				locals.payInput.slot = locals.slot;
+				CALL(PayRecentMiner, locals.payInput, locals.payOutput);
+				state.recentMinerSlots.removeByKey(locals.occupant.minerId);
+			}
+			state.recentMiners.set(locals.slot, locals.recentMiner);
+			state.totalMinerWeight += recentMinerWeight(locals.recentMiner);
+			state.recentMinerHeap.set(locals.slot, locals.slot);
+			state.recentMinerHeapPos.set(locals.slot, locals.slot);
+			state.recentMinerSlots.set(input.minerId, locals.slot);
+			state.recentMinerCount++;
+			locals.siftInput.heapPos = locals.slot;
+			CALL(SiftRecentMiner, locals.siftInput, locals.siftOutput);
+		}
+		else
+		{
+			// Replace lowest-ranked miner (heap root) if current qualifies
+			locals.slot = state.recentMinerHeap.get(0);
+			if (recentMinerRanksLower(state.recentMiners.get(locals.slot), locals.recentMiner))
+			{
+				locals.payInput.slot = locals.slot;
+				CALL(PayRecentMiner, locals.payInput, locals.payOutput);
+				state.perf.recentMinerEvictions++;
+				locals.eventInput.subject = state.recentMiners.get(locals.slot).minerId;
+				locals.eventInput.amount = state.validDepositAmounts.get(state.recentMiners.get(locals.slot).depositTier);
+				locals.eventInput.type = RANDOM_EVENT_EVICTION;
+				CALL(RecordEvent, locals.eventInput, locals.eventOutput);
+				state.totalMinerWeight += recentMinerWeight(locals.recentMiner) - recentMinerWeight(state.recentMiners.get(locals.slot));
+				state.recentMinerSlots.removeByKey(state.recentMiners.get(locals.slot).minerId);
+				state.recentMinerSlots.set(input.minerId, locals.slot);
+				state.recentMiners.set(locals.slot, locals.recentMiner);
+				locals.siftInput.heapPos = 0;
+				CALL(SiftRecentMiner, locals.siftInput, locals.siftOutput);
+			}
+		}
+	}
+
+	// --- Internal procedures (entropy sales) ---
+
+	struct ChargeEntropyPurchase_input
+	{
+		uint32 numberOfBytes;
+		uint64 minMinerDeposit;
+		uint64 entropyVersion;        // 0 selects the newest buyable version
+		bool   usePrepaid;            // debit the buyer's prepaid balance instead of the invocation reward
+	};
+	struct ChargeEntropyPurchase_output
+	{
+		bool   success;
+		uint64 usedMinerDeposit;
+		uint32 historySlot;
+	};
+	struct ChargeEntropyPurchase_locals
+	{
+		uint32 currentTick;
+		uint32 tier;
+		uint64 minPrice;
+		uint64 fee;
+		uint64 refund;
+		uint64 balance;
+		sint64 balanceIx;
+		uint64 half;
+		uint64 reward;
+		uint64 quotient;
+		uint64 scaled;
+		RANDOM_TierFreshness freshness;
+		RecordEvent_input eventInput;
+		RecordEvent_output eventOutput;
+	};
+
+	// ChargeEntropyPurchase: select the history slot, check miner eligibility and the buyer fee for a
+	// purchase. On failure the invocation reward is refunded; on success the fee is split between pools.
+	// With usePrepaid, the invocation reward is first credited to the buyer's prepaid balance, a failure
+	// neither refunds nor debits anything, and a success debits exactly the price.
+	PRIVATE_PROCEDURE_WITH_LOCALS(ChargeEntropyPurchase)
+	{
+		locals.currentTick = qpi.tick();
+		output.success = false;
+		output.usedMinerDeposit = 0;
+		locals.refund = qpi.invocationReward();
+
+		// Nothing to sell for zero bytes or at a zero price: refund before any balance is touched
+		locals.minPrice = calculatePrice(state, input.numberOfBytes, input.minMinerDeposit);
+		if (input.numberOfBytes == 0 || locals.minPrice == 0)
+		{
+			if (locals.refund > 0)
+			{
+				qpi.transfer(qpi.invocator(), locals.refund); // <-- refund buyer (empty purchase)
+				state.perf.refundsIssued++;
+			}
+			return;
+		}
+
+		if (input.usePrepaid)
+		{
+			locals.balanceIx = state.prepaidBalances.getElementIndex(qpi.invocator());
+			if (qpi.invocationReward() > 0)
+			{
+				locals.balance = (locals.balanceIx < 0) ? 0 : state.prepaidBalances.value(locals.balanceIx);
+				if (locals.balanceIx >= 0 || state.prepaidBalances.population() < RANDOM_MAX_PREPAID_BUYERS)
+				{
+					locals.balanceIx = state.prepaidBalances.set(qpi.invocator(), locals.balance + qpi.invocationReward());
+				}
+				if (locals.balanceIx < 0)
+				{
+					qpi.transfer(qpi.invocator(), qpi.invocationReward()); // <-- refund buyer (no balance slot free)
+					state.perf.refundsIssued++;
+					return;
+				}
+				state.totalPrepaidBalance += qpi.invocationReward();
+			}
+			locals.refund = 0;
+		}
+
+		// Disallow in early-epoch mode -- refund buyer
+		if (qpi.numberOfTickTransactions() == -1)
+		{
+			if (locals.refund > 0)
+			{
+				qpi.transfer(qpi.invocator(), locals.refund); // <-- refund buyer
+				state.perf.refundsIssued++;
+			}
+			return;
+		}
+
+		// Use the previous-but-one version by default (to avoid last-second reveals). An explicit version
+		// must not be newer than that and must still be in the history ring.
+		output.historySlot = (state.entropyPoolVersion - RANDOM_BUY_VERSION_LAG) & (RANDOM_ENTROPY_HISTORY_LEN - 1);
+		if (input.entropyVersion != 0)
+		{
+			output.historySlot = input.entropyVersion & (RANDOM_ENTROPY_HISTORY_LEN - 1);
+			if (state.entropyPoolVersion < RANDOM_BUY_VERSION_LAG ||
+				input.entropyVersion > state.entropyPoolVersion - RANDOM_BUY_VERSION_LAG ||
+				state.entropyPoolVersionHistory.get(output.historySlot) != input.entropyVersion)
+			{
+				if (locals.refund > 0)
+				{
+					qpi.transfer(qpi.invocator(), locals.refund); // <-- refund buyer (version unavailable)
+					state.perf.refundsIssued++;
+				}
+				return;
+			}
+		}
+
+		// Eligible if a miner with deposit >= minMinerDeposit revealed recently: map the requirement to
+		// the lowest tier that satisfies it (RANDOM_VALID_DEPOSIT_AMOUNTS if none does) and look up the
+		// freshest reveal at or above that tier.
+		locals.tier = RANDOM_DepositTiers::floorTier(input.minMinerDeposit);
+		locals.tier += (input.minMinerDeposit > state.validDepositAmounts.get(locals.tier));
+		if (locals.tier < RANDOM_VALID_DEPOSIT_AMOUNTS)
+		{
+			locals.freshness = state.freshestRevealAtTier.get(locals.tier);
+		}
+		if (locals.tier >= RANDOM_VALID_DEPOSIT_AMOUNTS || !locals.freshness.hasReveal ||
+			(locals.currentTick - locals.freshness.lastRevealTick) > state.revealTimeoutTicks)
+		{
+			if (locals.refund > 0)
+			{
+				qpi.transfer(qpi.invocator(), locals.refund); // <-- refund buyer (no entropy available)
+				state.perf.refundsIssued++;
+			}
+			return;
+		}
+
+		// Check buyer fee against the price (a prepaid buy pays exactly the price)
+		if (input.usePrepaid)
+		{
+			locals.balance = (locals.balanceIx < 0) ? 0 : state.prepaidBalances.value(locals.balanceIx);
+			if (locals.balanceIx < 0 || locals.balance < locals.minPrice)
+			{
+				return;
+			}
+			if (locals.balance == locals.minPrice)
+			{
+				state.prepaidBalances.removeByIndex(locals.balanceIx);
+			}
+			else
+			{
+				state.prepaidBalances.set(qpi.invocator(), locals.balance - locals.minPrice);
+			}
+			state.totalPrepaidBalance -= locals.minPrice;
+			locals.fee = locals.minPrice;
+		}
+		else
+		{
+			if ((uint64)qpi.invocationReward() < locals.minPrice)
+			{
+				if (qpi.invocationReward() > 0)
+				{
+					qpi.transfer(qpi.invocator(), qpi.invocationReward()); // <-- refund buyer (not enough fee)
+					state.perf.refundsIssued++;
+				}
+				return;
+			}
+			locals.fee = qpi.invocationReward();
+		}
+
+		locals.eventInput.subject = qpi.invocator();
+		locals.eventInput.amount = locals.fee;
+		locals.eventInput.type = RANDOM_EVENT_PURCHASE;
+		CALL(RecordEvent, locals.eventInput, locals.eventOutput);
+
+		// Split fee: half to miners pool, half to shareholders
+		locals.half = div(locals.fee, 2ULL);
+		state.minerEarningsPool += locals.half;
+		state.shareholderEarningsPool += (locals.fee - locals.half);
+
+		// Accrue the miners' half per unit of weight; the scaled remainder is carried so nothing is lost
+		locals.reward = locals.half + state.unassignedMinerReward;
+		state.unassignedMinerReward = 0;
+		if (state.totalMinerWeight == 0)
+		{
+			state.unassignedMinerReward = locals.reward;
+		}
+		else
+		{
+			// Split into quotient and remainder before scaling; a quotient too large to scale without
+			// overflow is capped and the excess waits in unassignedMinerReward for the next accrual
+			locals.quotient = div(locals.reward, state.totalMinerWeight);
+			if (locals.quotient > RANDOM_MAX_ACCRUAL_PER_WEIGHT)
+			{
+				state.unassignedMinerReward = (locals.quotient - RANDOM_MAX_ACCRUAL_PER_WEIGHT) * state.totalMinerWeight;
+				locals.quotient = RANDOM_MAX_ACCRUAL_PER_WEIGHT;
+			}
+			locals.scaled = mod(locals.reward, state.totalMinerWeight) * RANDOM_REWARD_SCALE + state.rewardRemainder;
+			state.rewardPerWeight += locals.quotient * RANDOM_REWARD_SCALE + div(locals.scaled, state.totalMinerWeight);
+			state.rewardRemainder = mod(locals.scaled, state.totalMinerWeight);
+		}
+
+		output.usedMinerDeposit = locals.freshness.revealerDeposit;
+		output.success = true;
+	}
+
+	// --- Internal procedures (mining) ---
+
+	struct OpenCommitment_input
+	{
+		id     revealedDigest;
+		uint32 firstSlot;             // head of the invocator's commitment list
+	};
+	struct OpenCommitment_output
+	{
+		bool   revealSuccessful;
+		uint64 depositReturned;
+	};
+	struct OpenCommitment_locals
+	{
+		uint32 slot;
+		uint8  depositTier;
+		uint64 amount;
+		RemoveCommitment_input removeInput;
+		RemoveCommitment_output removeOutput;
+		RecordRecentMiner_input recordInput;
+		RecordRecentMiner_output recordOutput;
+		RecordEvent_input eventInput;
+		RecordEvent_output eventOutput;
+	};
+
+	struct AcceptCommitment_input
+	{
+		id digest;
+	};
+	struct AcceptCommitment_output
+	{
+		bool success;
+	};
+	struct AcceptCommitment_locals
+	{
+		AddCommitment_input addInput;
+		AddCommitment_output addOutput;
+	};
+
+	// OpenCommitment: find the invocator's commitment to revealedDigest and open it. In time, the digest
+	// goes into the pool and the deposit is returned; late, the deposit is forfeited. Opens at most one.
+	PRIVATE_PROCEDURE_WITH_LOCALS(OpenCommitment)
+	{
+		for (locals.slot = input.firstSlot; locals.slot != RANDOM_INVALID_SLOT; locals.slot = state.commitmentOwnerNext.get(locals.slot))
+		{
+			state.perf.revealMatchIterations++;
+			if (state.commitmentDigests.get(locals.slot) != input.revealedDigest)
+			{
+				continue;
+			}
 
-	// --- QPI-compliant helpers ---
-	
-	// Simple helpers that avoid forbidden constructs in contracts.
+			locals.depositTier = state.commitmentDepositTiers.get(locals.slot);
+			locals.amount = state.validDepositAmounts.get(locals.depositTier);
+			if (qpi.tick() > state.commitmentDeadlines.get(locals.slot))
+			{
+				state.lostDepositsRevenue += locals.amount;
+				state.totalRevenue += locals.amount;
+				state.pendingShareholderDistribution += locals.amount;
+				state.totalForfeitedCommitments++;
+				locals.eventInput.type = RANDOM_EVENT_FORFEIT;
+			}
+			else
+			{
+				// Apply the 256-bit digest to the pool by XORing the 4 x 64-bit lanes
+				state.currentEntropyPool.u64._0 ^= input.revealedDigest.u64._0;
+				state.currentEntropyPool.u64._1 ^= input.revealedDigest.u64._1;
+				state.currentEntropyPool.u64._2 ^= input.revealedDigest.u64._2;
+				state.currentEntropyPool.u64._3 ^= input.revealedDigest.u64._3;
+				state.pendingRevealCount++;
+
+				qpi.transfer(qpi.invocator(), locals.amount);
+				output.revealSuccessful = true;
+				output.depositReturned = locals.amount;
+				state.totalReveals++;
+				locals.eventInput.type = RANDOM_EVENT_REVEAL;
+
+				locals.recordInput.minerId = qpi.invocator();
+				locals.recordInput.depositTier = locals.depositTier;
+				CALL(RecordRecentMiner, locals.recordInput, locals.recordOutput);
+			}
 
-	static inline bool validDepositAmountAt(const RANDOM& stateRef, uint64 amount, uint32 idx)
-	{
-		return amount == stateRef.validDepositAmounts.get(idx);
-	}
+			locals.eventInput.subject = qpi.invocator();
+			locals.eventInput.amount = locals.amount;
+			CALL(RecordEvent, locals.eventInput, locals.eventOutput);
 
-	static inline bool isEqualIdCheck(const id& a, const id& b)
-	{
-		return a == b;
+			state.totalSecurityDepositsLocked -= locals.amount;
+			locals.removeInput.slot = locals.slot;
+			CALL(RemoveCommitment, locals.removeInput, locals.removeOutput);
+			return;
+		}
 	}
 
-	static inline bool isZeroIdCheck(const id& value)
-	{
-		return isZero(value);
-	}
-	
-	static inline uint64 calculatePrice(const RANDOM& state, uint32 numberOfBytes, uint64 minMinerDeposit)
+	// AcceptCommitment: store a commitment to digest with the invocation reward as deposit if that is
+	// a valid deposit of at least minimumSecurityDeposit; a rejected deposit is refunded
+	PRIVATE_PROCEDURE_WITH_LOCALS(AcceptCommitment)
 	{
-	    return state.pricePerByte * numberOfBytes *
-	        (div(minMinerDeposit, state.priceDepositDivisor) + 1ULL);
+		if (!isValidDeposit(state, qpi.invocationReward()) || (uint64)qpi.invocationReward() < state.minimumSecurityDeposit)
+		{
+			if (qpi.invocationReward() > 0)
+			{
+				qpi.transfer(qpi.invocator(), qpi.invocationReward()); // <-- refund deposit (invalid amount)
+				state.perf.refundsIssued++;
+			}
+			return;
+		}
+		locals.addInput.digest = input.digest;
+		locals.addInput.invocatorId = qpi.invocator();
+		locals.addInput.depositTier = uint8(RANDOM_DepositTiers::floorTier(qpi.invocationReward()));
+		CALL(AddCommitment, locals.addInput, locals.addOutput);
+		output.success = locals.addOutput.success;
+		if (!locals.addOutput.success)
+		{
+			qpi.transfer(qpi.invocator(), qpi.invocationReward()); // <-- refund deposit (storage full)
+			state.perf.refundsIssued++;
+		}
 	}
 
 public:
@@ -121,6 +1221,64 @@ public:
 		uint64 depositReturned;
 	};
 
+	// Compact mining flow: commits to K12(seed) of a 32-byte seed and reveals that seed later
+	// (64 input bytes instead of 544, and the reveal hashes 32 bytes instead of 512). Otherwise
+	// the same as RevealAndCommit; a commitment opens with the format it was made for.
+	struct RevealAndCommitCompact_input
+	{
+		id revealedSeed;
+		id committedDigest;
+	};
+	struct RevealAndCommitCompact_output
+	{
+		uint64 entropyVersion;
+		bool   revealSuccessful;
+		bool   commitSuccessful;
+		uint64 depositReturned;
+	};
+
+	// Single-phase mining calls with minimal inputs: Commit stores a commitment to committedDigest with
+	// the invocation reward as deposit (refunded if rejected); Reveal opens a seed commitment (as made by
+	// Commit, RevealAndCommitCompact or the batch) and takes no reward.
+	struct Commit_input
+	{
+		id committedDigest;
+	};
+	struct Commit_output
+	{
+		bool commitSuccessful;
+	};
+
+	struct Reveal_input
+	{
+		id revealedSeed;
+	};
+	struct Reveal_output
+	{
+		uint64 entropyVersion;
+		bool   revealSuccessful;
+		uint64 depositReturned;
+	};
+
+	// Batch of parallel mining flows. A flow commits to K12(seed) of a 32-byte seed (a full
+	// bit_4096 reveal per flow would not fit into one transaction) and reveals that seed later.
+	// A zero seed skips the reveal, a zero digest skips the new commitment. The invocation reward
+	// is split evenly over the new commitments; each share must be a valid deposit.
+	struct RevealAndCommitBatch_input
+	{
+		Array<id, RANDOM_MAX_BATCH_FLOWS> revealedSeeds;
+		Array<id, RANDOM_MAX_BATCH_FLOWS> committedDigests;
+		uint32 flowCount;
+	};
+	struct RevealAndCommitBatch_output
+	{
+		uint64 entropyVersion;
+		uint64 depositReturned;
+		uint32 revealedCount;
+		uint32 forfeitedCount;
+		uint32 committedCount;
+	};
+
 	struct GetContractInfo_input {};
 	struct GetContractInfo_output
 	{
@@ -139,6 +1297,9 @@ public:
 		uint64 minerEarningsPool;
 		uint64 shareholderEarningsPool;
 		uint32 recentMinerCount;
+		uint64 totalForfeitedCommitments;
+		uint64 totalRefundedCommitments;
+		uint64 totalPrepaidBalance;
 	};
 
 	struct GetUserCommitments_input
@@ -162,7 +1323,9 @@ public:
 	struct BuyEntropy_input
 	{
 		uint32 numberOfBytes;
+		bool   usePrepaid;            // pay from the prepaid balance (see DepositPrepaid); sits in former padding
 		uint64 minMinerDeposit;
+		uint64 entropyVersion;        // pool version to draw from; 0 = previous-but-one (default)
 	};
 	struct BuyEntropy_output
 	{
@@ -173,9 +1336,146 @@ public:
 		uint64 usedPoolVersion;
 	};
 
+	struct BuyEntropyBulk_input
+	{
+		uint32 numberOfBytes;         // 1..RANDOM_BULK_RANDOMBYTES_LEN
+		bool   usePrepaid;            // as in BuyEntropy_input
+		uint64 minMinerDeposit;
+		uint64 entropyVersion;        // as in BuyEntropy_input
+	};
+	struct BuyEntropyBulk_output
+	{
+		bool   success;
+		Array<uint8, RANDOM_BULK_RANDOMBYTES_LEN> randomBytes;
+		uint64 entropyVersion;
+		uint64 usedMinerDeposit;
+		uint64 usedPoolVersion;
+	};
+
+	struct ClaimEarnings_input {};
+	struct ClaimEarnings_output
+	{
+		uint64 amount;
+	};
+
+	struct DepositPrepaid_input {};
+	struct DepositPrepaid_output
+	{
+		bool   success;
+		uint64 balance;
+	};
+
+	struct WithdrawPrepaid_input
+	{
+		uint64 amount;                // 0 withdraws the whole balance
+	};
+	struct WithdrawPrepaid_output
+	{
+		uint64 withdrawn;
+		uint64 balance;
+	};
+
+	struct GetPrepaidBalance_input
+	{
+		id buyerId;
+	};
+	struct GetPrepaidBalance_output
+	{
+		uint64 balance;
+	};
+
+	struct GetEntropyAtVersion_input
+	{
+		uint64 entropyVersion;
+	};
+	struct GetEntropyAtVersion_output
+	{
+		bool   found;                 // version is in the history ring and no longer the default buy version
+		m256i  entropyPool;
+		uint32 tick;                  // tick at which the version was recorded
+		uint64 oldestVersion;         // oldest version still held in the ring
+		uint64 newestBuyableVersion;  // version BuyEntropy uses by default
+	};
+
+	// Per deposit tier t (minMinerDeposit <= validDepositAmounts[t]): whether a BuyEntropy at the current
+	// tick would find a fresh reveal, and the first tick at which that reveal no longer qualifies.
+	struct GetAvailableSecurity_input {};
+	struct GetAvailableSecurity_output
+	{
+		Array<bool, RANDOM_VALID_DEPOSIT_AMOUNTS> available;
+		Array<uint32, RANDOM_VALID_DEPOSIT_AMOUNTS> staleAtTick;        // 0 if the tier has no reveal
+		Array<uint64, RANDOM_VALID_DEPOSIT_AMOUNTS> revealerDeposit;    // deposit that BuyEntropy would report
+		Array<uint64, RANDOM_VALID_DEPOSIT_AMOUNTS> validDepositAmounts;
+		uint32 currentTick;
+	};
+
+	struct GetPerfCounters_input {};
+	struct GetPerfCounters_output
+	{
+		RANDOM_PerfCounters counters;
+		uint32 activeCommitments;     // occupancy at the time of the query, for correlation
+		uint32 recentMinerCount;
+		uint32 currentTick;
+	};
+
+	// Paged snapshots for indexers: pass cursor 0 first, then nextCursor until it is 0. The pages form a
+	// consistent snapshot only if stateVersion is the same in all of them.
+	struct GetCommitmentsPage_input
+	{
+		uint32 cursor;                // first commitment slot of the page
+	};
+	struct GetCommitmentsPage_output
+	{
+		Array<RANDOM_CommitmentRecord, RANDOM_SNAPSHOT_PAGE_LEN> commitments;
+		uint32 count;
+		uint32 nextCursor;            // 0 after the last page
+		uint32 totalCount;
+		uint64 stateVersion;
+	};
+
+	struct GetRecentMinersPage_input
+	{
+		uint32 cursor;                // first recentMiners slot to scan
+	};
+	struct GetRecentMinersPage_output
+	{
+		Array<RANDOM_RecentMiner, RANDOM_SNAPSHOT_PAGE_LEN> miners;  // occupied slots only, in slot order
+		uint32 count;
+		uint32 nextCursor;            // 0 after the last page
+		uint32 recentMinerCount;      // slots below this belong to the current generation
+		uint32 recentMinerGeneration; // entries of older generations are stale but still claimable
+		uint64 rewardPerWeight;
+		uint64 stateVersion;
+	};
+
+	// Events with seq >= input.seq, oldest first. Pass nextSeq back in to tail the ring; missedEvents is
+	// set when events between seq and oldestSeq were already overwritten.
+	struct GetEventsSince_input
+	{
+		uint64 seq;
+	};
+	struct GetEventsSince_output
+	{
+		Array<RANDOM_Event, RANDOM_EVENT_PAGE_LEN> events;
+		uint32 count;
+		uint64 nextSeq;
+		uint64 oldestSeq;             // oldest event still in the ring
+		bool   missedEvents;
+	};
+
 	struct QueryPrice_input { uint32 numberOfBytes; uint64 minMinerDeposit; };
 	struct QueryPrice_output { uint64 price; };
 
+	// Full price table: prices[(numberOfBytes - 1) * RANDOM_VALID_DEPOSIT_AMOUNTS + tier] is the price of
+	// numberOfBytes bytes at minMinerDeposit = validDepositAmounts[tier]. The pricing inputs are only set by
+	// INITIALIZE, so the table stays valid for the lifetime of the contract.
+	struct QueryPriceMatrix_input {};
+	struct QueryPriceMatrix_output
+	{
+		Array<uint64, RANDOM_RANDOMBYTES_LEN * RANDOM_VALID_DEPOSIT_AMOUNTS> prices;
+		Array<uint64, RANDOM_VALID_DEPOSIT_AMOUNTS> validDepositAmounts;
+	};
+
 	//---- Locals storage for procedures ---
 
 	struct RevealAndCommit_locals
@@ -184,407 +1484,501 @@ public:
 		bool hasRevealData;
 		bool hasNewCommit;
 		bool isStoppingMining;
-		sint32 existingIndex;
+		sint64 ownerIx;
 		uint32 i;
-		uint32 rm;
-		uint32 lowestIx;
-		bool hashMatches;
 
 		// locals for random-bytes generation (no stack locals)
 		uint32 histIdx;
 		uint32 rb_i;
 
-		// precompute K12 digest of revealedBits once per call
-		id revealedDigest;
-
-		// per-iteration commitment
-		RANDOM_EntropyCommitment cmt;
-
-		// per-iteration temporaries (moved into locals for compliance)
-		uint64 lostDeposit;
-		RANDOM_RecentMiner recentMinerA;
-		RANDOM_RecentMiner recentMinerB;
-
-		// deposit validity flag moved into locals
-		bool depositValid;
-
-		// temporary used to create new commitments (moved out of stack)
-		RANDOM_EntropyCommitment ncmt;
+		// internal procedure calls
+		OpenCommitment_input openInput;
+		OpenCommitment_output openOutput;
+		AcceptCommitment_input acceptInput;
+		AcceptCommitment_output acceptOutput;
+	};
+	struct RevealAndCommitCompact_locals
+	{
+		sint64 ownerIx;
+		OpenCommitment_input openInput;
+		OpenCommitment_output openOutput;
+		AcceptCommitment_input acceptInput;
+		AcceptCommitment_output acceptOutput;
+	};
+	struct Commit_locals
+	{
+		AcceptCommitment_input acceptInput;
+		AcceptCommitment_output acceptOutput;
+	};
+	struct Reveal_locals
+	{
+		sint64 ownerIx;
+		OpenCommitment_input openInput;
+		OpenCommitment_output openOutput;
+	};
+	struct RevealAndCommitBatch_locals
+	{
+		uint32 currentTick;
+		uint32 flow;
+		uint32 i;
+		uint32 j;
+		uint32 slot;
+		uint32 matchedCount;
+		uint32 newCommitCount;
+		sint64 ownerIx;
+		uint32 ownerHead;
+		uint64 amount;
+		uint64 share;
+		uint8  depositTier;
+		uint8  bestDepositTier;
+		id     seedDigest;
+		m256i  poolDelta;
+		bool   alreadyMatched;
+		Array<uint32, RANDOM_MAX_BATCH_FLOWS> matchedSlots;
+
+		RemoveCommitment_input removeInput;
+		RemoveCommitment_output removeOutput;
+		AddCommitment_input addInput;
+		AddCommitment_output addOutput;
+		RecordRecentMiner_input recordInput;
+		RecordRecentMiner_output recordOutput;
+		RecordEvent_input eventInput;
+		RecordEvent_output eventOutput;
 	};
 	struct BuyEntropy_locals
 	{
 		uint32 currentTick;
-		bool eligible;
-		uint64 usedMinerDeposit;
 		uint32 i;
-		uint64 minPrice;
-		uint64 buyerFee;
 		uint32 histIdx;
-		uint64 half;
 
-		RANDOM_EntropyCommitment cmt;
+		ChargeEntropyPurchase_input chargeInput;
+		ChargeEntropyPurchase_output chargeOutput;
+	};
+	struct BuyEntropyBulk_locals
+	{
+		uint32 histIdx;
+		uint32 i;
+		id     block;
+		RANDOM_BulkExpansionBlock expansion;
 
-		// per-iteration temporaries
-		uint64 lostDeposit;
-		RANDOM_RecentMiner recentMinerTemp;
+		ChargeEntropyPurchase_input chargeInput;
+		ChargeEntropyPurchase_output chargeOutput;
+	};
+	struct ClaimEarnings_locals
+	{
+		sint64 minerIx;
+		PayRecentMiner_input payInput;
+		PayRecentMiner_output payOutput;
+	};
+	struct DepositPrepaid_locals
+	{
+		sint64 balanceIx;
+	};
+	struct WithdrawPrepaid_locals
+	{
+		sint64 balanceIx;
+	};
+	struct GetPrepaidBalance_locals
+	{
+		sint64 balanceIx;
 	};
 	struct END_EPOCH_locals
 	{
 		uint32 currentTick;
 		uint32 i;
-		uint64 payout;
-
-		RANDOM_EntropyCommitment cmt;
 
 		// per-iteration temporaries
-		uint64 lostDeposit;
 		RANDOM_RecentMiner recentMinerTemp;
+		RANDOM_TierFreshness freshness;
+
+		PayRecentMiner_input payInput;
+		PayRecentMiner_output payOutput;
 	};
 	struct GetUserCommitments_locals
 	{
 		uint32 userCommitmentCount;
 		uint32 i;
+		sint64 ownerIx;
 
-		RANDOM_EntropyCommitment cmt;
 		GetUserCommitments_output::UserCommitment ucmt;
 	};
 	struct GetContractInfo_locals
 	{
-		uint32 currentTick;
-		uint32 activeCount;
-		uint32 i;
-	};
-	struct INITIALIZE_locals
+		uint32 currentTick;
+	};
+	struct GetCommitmentsPage_locals
+	{
+		uint32 slot;
+		RANDOM_CommitmentRecord record;
+	};
+	struct GetRecentMinersPage_locals
+	{
+		uint32 slot;
+		uint32 scanned;
+	};
+	struct GetEventsSince_locals
+	{
+		uint64 seq;
+	};
+	struct GetAvailableSecurity_locals
+	{
+		uint32 tier;
+		RANDOM_TierFreshness freshness;
+	};
+	struct QueryPriceMatrix_locals
+	{
+		uint32 numberOfBytes;
+		uint32 tier;
+	};
+	struct BEGIN_TICK_locals
+	{
+		SweepExpiredCommitments_input sweepInput;
+		SweepExpiredCommitments_output sweepOutput;
+		RefundEmptyTickCommitments_input refundInput;
+		RefundEmptyTickCommitments_output refundOutput;
+	};
+	struct END_TICK_locals
+	{
+		uint32 histIdx;
+	};
+	struct INITIALIZE_locals
+	{
+		uint32 i;
+	};
+
+	// --------------------------------------------------
+	// RevealAndCommit procedure (expired commitments were already handled by BEGIN_TICK):
+	// - Optionally processes a reveal (preimage) and returns deposit if valid
+	// - Optionally accepts a new commitment (invocation reward as deposit)
+
+	PUBLIC_PROCEDURE_WITH_LOCALS(RevealAndCommit)
+	{
+		locals.currentTick = qpi.tick();
+
+		// Early-epoch mode: deposits due this tick were refunded by BEGIN_TICK, nothing else to do
+		if (qpi.numberOfTickTransactions() == -1)
+		{
+			return;
+		}
+
+		locals.hasNewCommit = !isZeroIdCheck(input.committedDigest);
+		locals.isStoppingMining = (qpi.invocationReward() == 0);
+
+		// Walk this invocator's commitment list for the commitment the reveal opens. Without a pending
+		// commitment (first commit of a flow, zero revealedBits) nothing can match, so the K12 over the
+		// 512-byte revealedBits is only computed once the list is known to be non-empty.
+		locals.ownerIx = state.commitmentOwners.getElementIndex(qpi.invocator());
+		locals.i = (locals.ownerIx < 0) ? RANDOM_INVALID_SLOT : state.commitmentOwners.value(locals.ownerIx);
+		locals.hasRevealData = (locals.i != RANDOM_INVALID_SLOT);
+		if (locals.hasRevealData)
+		{
+			locals.openInput.revealedDigest = qpi.K12(input.revealedBits);
+			locals.openInput.firstSlot = locals.i;
+			state.perf.revealDigestsComputed++;
+			CALL(OpenCommitment, locals.openInput, locals.openOutput);
+			output.revealSuccessful = locals.openOutput.revealSuccessful;
+			output.depositReturned = locals.openOutput.depositReturned;
+		}
+
+		// If caller provided a new commitment (invocationReward used as deposit) and not stopping mining,
+		// accept it if deposit is valid and meets minimum.
+		if (locals.hasNewCommit && !locals.isStoppingMining)
+		{
+			locals.acceptInput.digest = input.committedDigest;
+			CALL(AcceptCommitment, locals.acceptInput, locals.acceptOutput);
+			output.commitSuccessful = locals.acceptOutput.success;
+		}
+
+		// Produce 32 random-like bytes from latest entropy history and current tick:
+		// - take most recent history entry (histIdx) and extract bytes from its 64-bit lanes,
+		// - XOR first 8 bytes with tick-derived bytes to add per-tick variation.
+		locals.histIdx = state.entropyPoolVersion & (RANDOM_ENTROPY_HISTORY_LEN - 1);
+		for (locals.rb_i = 0; locals.rb_i < RANDOM_RANDOMBYTES_LEN; ++locals.rb_i)
+		{
+			// Extract the correct 64-bit lane and then the requested byte without using plain [].
+			output.randomBytes.set(
+				locals.rb_i,
+				static_cast<uint8_t>(
+					(
+						(
+							(locals.rb_i < 8) ? state.entropyHistory.get(locals.histIdx).u64._0 :
+							(locals.rb_i < 16) ? state.entropyHistory.get(locals.histIdx).u64._1 :
+							(locals.rb_i < 24) ? state.entropyHistory.get(locals.histIdx).u64._2 :
+							state.entropyHistory.get(locals.histIdx).u64._3
+							) >> (8 * (locals.rb_i & 7))
+						) & 0xFF
+					) ^
+				(locals.rb_i < 8 ? static_cast<uint8_t>((static_cast<uint64_t>(locals.currentTick) >> (8 * locals.rb_i)) & 0xFF) : 0)
+			);
+		}
+
+		output.entropyVersion = state.entropyPoolVersion;
+	}
+
+	// RevealAndCommitCompact procedure: RevealAndCommit with a 32-byte seed as the preimage
+	PUBLIC_PROCEDURE_WITH_LOCALS(RevealAndCommitCompact)
+	{
+		if (qpi.numberOfTickTransactions() == -1)
+		{
+			if (qpi.invocationReward() > 0)
+			{
+				qpi.transfer(qpi.invocator(), qpi.invocationReward());
+				state.perf.refundsIssued++;
+			}
+			return;
+		}
+
+		locals.ownerIx = state.commitmentOwners.getElementIndex(qpi.invocator());
+		if (locals.ownerIx >= 0)
+		{
+			locals.openInput.revealedDigest = qpi.K12(input.revealedSeed);
+			locals.openInput.firstSlot = state.commitmentOwners.value(locals.ownerIx);
+			state.perf.revealDigestsComputed++;
+			CALL(OpenCommitment, locals.openInput, locals.openOutput);
+			output.revealSuccessful = locals.openOutput.revealSuccessful;
+			output.depositReturned = locals.openOutput.depositReturned;
+		}
+
+		if (!isZeroIdCheck(input.committedDigest) && qpi.invocationReward() > 0)
+		{
+			locals.acceptInput.digest = input.committedDigest;
+			CALL(AcceptCommitment, locals.acceptInput, locals.acceptOutput);
+			output.commitSuccessful = locals.acceptOutput.success;
+		}
+		else if (qpi.invocationReward() > 0)
+		{
+			qpi.transfer(qpi.invocator(), qpi.invocationReward()); // <-- refund (nothing to commit)
+			state.perf.refundsIssued++;
+		}
+
+		output.entropyVersion = state.entropyPoolVersion;
+	}
+
+	// Commit procedure: the commit half of RevealAndCommit only (no reveal match, no hashing);
+	// AcceptCommitment validates the deposit and refunds it if rejected
+	PUBLIC_PROCEDURE_WITH_LOCALS(Commit)
+	{
+		if (qpi.numberOfTickTransactions() == -1 || isZeroIdCheck(input.committedDigest))
+		{
+			if (qpi.invocationReward() > 0)
+			{
+				qpi.transfer(qpi.invocator(), qpi.invocationReward()); // <-- refund deposit (nothing to commit)
+				state.perf.refundsIssued++;
+			}
+			return;
+		}
+		locals.acceptInput.digest = input.committedDigest;
+		CALL(AcceptCommitment, locals.acceptInput, locals.acceptOutput);
+		output.commitSuccessful = locals.acceptOutput.success;
+	}
+
+	// Reveal procedure: the reveal half of RevealAndCommitCompact only
+	PUBLIC_PROCEDURE_WITH_LOCALS(Reveal)
 	{
-		uint32 i;
-		uint32 j;
-		uint64 val;
-	};
+		if (qpi.invocationReward() > 0)
+		{
+			qpi.transfer(qpi.invocator(), qpi.invocationReward());
+			state.perf.refundsIssued++;
+		}
+		if (qpi.numberOfTickTransactions() == -1)
+		{
+			return;
+		}
 
-	// --------------------------------------------------
-	// RevealAndCommit procedure:
-	// - Removes expired commitments
-	// - Optionally processes a reveal (preimage) and returns deposit if valid
-	// - Optionally accepts a new commitment (invocation reward as deposit)
+		locals.ownerIx = state.commitmentOwners.getElementIndex(qpi.invocator());
+		if (locals.ownerIx >= 0)
+		{
+			locals.openInput.revealedDigest = qpi.K12(input.revealedSeed);
+			locals.openInput.firstSlot = state.commitmentOwners.value(locals.ownerIx);
+			state.perf.revealDigestsComputed++;
+			CALL(OpenCommitment, locals.openInput, locals.openOutput);
+			output.revealSuccessful = locals.openOutput.revealSuccessful;
+			output.depositReturned = locals.openOutput.depositReturned;
+		}
+		output.entropyVersion = state.entropyPoolVersion;
+	}
 
-	PUBLIC_PROCEDURE_WITH_LOCALS(RevealAndCommit)
+	// RevealAndCommitBatch procedure: RevealAndCommit for up to RANDOM_MAX_BATCH_FLOWS flows with one
+	// owner index lookup, one pool update and one recentMiners update for the whole batch.
+	PUBLIC_PROCEDURE_WITH_LOCALS(RevealAndCommitBatch)
 	{
 		locals.currentTick = qpi.tick();
-
-		// Remove expired commitments (sweep) -- reclaim lost deposits into revenue pools
-		for (locals.i = 0; locals.i < state.commitmentCount;)
+		if (qpi.numberOfTickTransactions() == -1 || input.flowCount > RANDOM_MAX_BATCH_FLOWS)
 		{
-			locals.cmt = state.commitments.get(locals.i);
-			if (!locals.cmt.hasRevealed && locals.currentTick > locals.cmt.revealDeadlineTick)
-			{
-				// Move deposit into lost revenue and remove commitment (swap-with-last)
-				locals.lostDeposit = locals.cmt.amount;
-				state.lostDepositsRevenue += locals.lostDeposit;
-				state.totalRevenue += locals.lostDeposit;
-				state.pendingShareholderDistribution += locals.lostDeposit;
-				state.totalSecurityDepositsLocked -= locals.lostDeposit;
-				if (locals.i != state.commitmentCount - 1)
-				{
-					locals.cmt = state.commitments.get(state.commitmentCount - 1);
-					state.commitments.set(locals.i, locals.cmt);
-				}
-				state.commitmentCount--;
-			}
-			else
+			if (qpi.invocationReward() > 0)
 			{
-				locals.i++;
+				qpi.transfer(qpi.invocator(), qpi.invocationReward()); // <-- refund deposits (nothing committed)
+				state.perf.refundsIssued++;
 			}
+			return;
 		}
 
-		// Special-case early epoch: forcibly return deposits that expire exactly this tick
-		if (qpi.numberOfTickTransactions() == -1)
+		// Match every revealed seed against the invocator's commitment list
+		locals.ownerIx = state.commitmentOwners.getElementIndex(qpi.invocator());
+		locals.ownerHead = (locals.ownerIx < 0) ? RANDOM_INVALID_SLOT : state.commitmentOwners.value(locals.ownerIx);
+		locals.matchedCount = 0;
+		for (locals.flow = 0; locals.flow < input.flowCount; ++locals.flow)
 		{
-			for (locals.i = 0; locals.i < state.commitmentCount;)
+			if (isZeroIdCheck(input.revealedSeeds.get(locals.flow)))
+			{
+				continue;
+			}
+			locals.seedDigest = qpi.K12(input.revealedSeeds.get(locals.flow));
+			for (locals.slot = locals.ownerHead; locals.slot != RANDOM_INVALID_SLOT; locals.slot = state.commitmentOwnerNext.get(locals.slot))
 			{
-				locals.cmt = state.commitments.get(locals.i);
-				if (!locals.cmt.hasRevealed && locals.cmt.revealDeadlineTick == qpi.tick())
+				state.perf.revealMatchIterations++;
+				if (state.commitmentDigests.get(locals.slot) != locals.seedDigest)
 				{
-					// refund directly in early epoch mode
-					qpi.transfer(locals.cmt.invocatorId, locals.cmt.amount);
-					state.totalSecurityDepositsLocked -= locals.cmt.amount;
-					if (locals.i != state.commitmentCount - 1)
+					continue;
+				}
+				// The same seed twice in one batch opens each matching commitment only once
+				locals.alreadyMatched = false;
+				for (locals.i = 0; locals.i < locals.matchedCount; ++locals.i)
+				{
+					if (locals.matchedSlots.get(locals.i) == locals.slot)
 					{
-						locals.cmt = state.commitments.get(state.commitmentCount - 1);
-						state.commitments.set(locals.i, locals.cmt);
+						locals.alreadyMatched = true;
 					}
-					state.commitmentCount--;
+				}
+				if (locals.alreadyMatched)
+				{
+					continue;
+				}
+
+				locals.depositTier = state.commitmentDepositTiers.get(locals.slot);
+				locals.amount = state.validDepositAmounts.get(locals.depositTier);
+				if (locals.currentTick > state.commitmentDeadlines.get(locals.slot))
+				{
+					state.lostDepositsRevenue += locals.amount;
+					state.totalRevenue += locals.amount;
+					state.pendingShareholderDistribution += locals.amount;
+					state.totalForfeitedCommitments++;
+					output.forfeitedCount++;
+					locals.eventInput.type = RANDOM_EVENT_FORFEIT;
 				}
 				else
 				{
-					locals.i++;
+					locals.poolDelta.u64._0 ^= locals.seedDigest.u64._0;
+					locals.poolDelta.u64._1 ^= locals.seedDigest.u64._1;
+					locals.poolDelta.u64._2 ^= locals.seedDigest.u64._2;
+					locals.poolDelta.u64._3 ^= locals.seedDigest.u64._3;
+					output.depositReturned += locals.amount;
+					output.revealedCount++;
+					state.totalReveals++;
+					if (locals.depositTier > locals.bestDepositTier)
+					{
+						locals.bestDepositTier = locals.depositTier;
+					}
+					locals.eventInput.type = RANDOM_EVENT_REVEAL;
 				}
+				locals.eventInput.subject = qpi.invocator();
+				locals.eventInput.amount = locals.amount;
+				CALL(RecordEvent, locals.eventInput, locals.eventOutput);
+				state.totalSecurityDepositsLocked -= locals.amount;
+				locals.matchedSlots.set(locals.matchedCount, locals.slot);
+				locals.matchedCount++;
+				break;
 			}
-			return;
 		}
 
-		// Precompute digest of revealedBits once to avoid forbidden casts into bit_4096
-		locals.revealedDigest = qpi.K12(input.revealedBits);
-
-		// Presence of reveal is treated as an attempt to match stored digests
-		locals.hasRevealData = true;
-		locals.hasNewCommit = !isZeroIdCheck(input.committedDigest);
-		locals.isStoppingMining = (qpi.invocationReward() == 0);
-
-		// If reveal provided: search for matching commitment(s) by this invocator
-		for (locals.i = 0; locals.i < state.commitmentCount;)
+		// Remove opened commitments from the highest slot down, so swap-with-last never moves a
+		// commitment that is still waiting to be removed
+		for (locals.i = 1; locals.i < locals.matchedCount; ++locals.i)
 		{
-			locals.cmt = state.commitments.get(locals.i);
-			if (!locals.cmt.hasRevealed && isEqualIdCheck(locals.cmt.invocatorId, qpi.invocator()))
+			locals.slot = locals.matchedSlots.get(locals.i);
+			for (locals.j = locals.i; locals.j > 0 && locals.matchedSlots.get(locals.j - 1) < locals.slot; --locals.j)
 			{
-				// Compare stored digest to precomputed K12(revealedBits)
-				locals.hashMatches = (locals.cmt.digest == locals.revealedDigest);
+				locals.matchedSlots.set(locals.j, locals.matchedSlots.get(locals.j - 1));
+			}
+			locals.matchedSlots.set(locals.j, locals.slot);
+		}
+		for (locals.i = 0; locals.i < locals.matchedCount; ++locals.i)
+		{
+			locals.removeInput.slot = locals.matchedSlots.get(locals.i);
+			CALL(RemoveCommitment, locals.removeInput, locals.removeOutput);
+		}
 
-				if (locals.hashMatches)
-				{
-					// If reveal too late, deposit is forfeited; otherwise update entropy pool and refund.
-					if (locals.currentTick > locals.cmt.revealDeadlineTick)
-					{
-						locals.lostDeposit = locals.cmt.amount;
-						state.lostDepositsRevenue += locals.lostDeposit;
-						state.totalRevenue += locals.lostDeposit;
-						state.pendingShareholderDistribution += locals.lostDeposit;
-						output.revealSuccessful = false;
-					}
-					else
-					{
-						// Apply the 256-bit digest to the pool by XORing the 4 x 64-bit lanes.
-						// This avoids inspecting bit_4096 internals and keeps everything QPI-compliant.
-						state.currentEntropyPool.u64._0 ^= locals.revealedDigest.u64._0;
-						state.currentEntropyPool.u64._1 ^= locals.revealedDigest.u64._1;
-						state.currentEntropyPool.u64._2 ^= locals.revealedDigest.u64._2;
-						state.currentEntropyPool.u64._3 ^= locals.revealedDigest.u64._3;
-
-						// Advance circular history with copy of new pool and bump version.
-						state.entropyHistoryHead = (state.entropyHistoryHead + 1) & (RANDOM_ENTROPY_HISTORY_LEN - 1);
-						state.entropyHistory.set(state.entropyHistoryHead, state.currentEntropyPool);
-
-						state.entropyPoolVersion++;
-						state.entropyPoolVersionHistory.set(state.entropyHistoryHead, state.entropyPoolVersion);
-
-						// Refund deposit to invocator and update stats.
-						qpi.transfer(qpi.invocator(), locals.cmt.amount);
-						output.revealSuccessful = true;
-						output.depositReturned = locals.cmt.amount;
-						state.totalReveals++;
-						state.totalSecurityDepositsLocked -= locals.cmt.amount;
-
-						// Maintain recentMiners LRU: update existing entry, append if space, or replace lowest.
-						locals.existingIndex = -1;
-						for (locals.rm = 0; locals.rm < state.recentMinerCount; ++locals.rm)
-						{
-							locals.recentMinerA = state.recentMiners.get(locals.rm);
-							if (isEqualIdCheck(locals.recentMinerA.minerId, qpi.invocator()))
-							{
-								locals.existingIndex = locals.rm;
-								break;
-							}
-						}
-						if (locals.existingIndex >= 0)
-						{
-							// update stored recent miner entry
-							locals.recentMinerA = state.recentMiners.get(locals.existingIndex);
-							if (locals.recentMinerA.deposit < locals.cmt.amount)
-							{
-								locals.recentMinerA.deposit = locals.cmt.amount;
-								locals.recentMinerA.lastEntropyVersion = state.entropyPoolVersion;
-							}
-							locals.recentMinerA.lastRevealTick = locals.currentTick;
-							state.recentMiners.set(locals.existingIndex, locals.recentMinerA);
-						}
-						else if (state.recentMinerCount < RANDOM_MAX_RECENT_MINERS)
-						{
-							// append new recent miner
-							locals.recentMinerA.minerId = qpi.invocator();
-							locals.recentMinerA.deposit = locals.cmt.amount;
-							locals.recentMinerA.lastEntropyVersion = state.entropyPoolVersion;
-							locals.recentMinerA.lastRevealTick = locals.currentTick;
-							state.recentMiners.set(state.recentMinerCount, locals.recentMinerA);
-							state.recentMinerCount++;
-						}
-						else
-						{
-							// Find lowest-ranked miner and replace if current qualifies
-							locals.lowestIx = 0;
-							for (locals.rm = 1; locals.rm < RANDOM_MAX_RECENT_MINERS; ++locals.rm)
-							{
-								locals.recentMinerA = state.recentMiners.get(locals.rm);
-								locals.recentMinerB = state.recentMiners.get(locals.lowestIx);
-								if (locals.recentMinerA.deposit < locals.recentMinerB.deposit ||
-									(locals.recentMinerA.deposit == locals.recentMinerB.deposit && locals.recentMinerA.lastEntropyVersion < locals.recentMinerB.lastEntropyVersion))
-								{
-									locals.lowestIx = locals.rm;
-								}
-							}
-							locals.recentMinerA = state.recentMiners.get(locals.lowestIx);
-							if (
-								locals.cmt.amount > locals.recentMinerA.deposit ||
-								(locals.cmt.amount == locals.recentMinerA.deposit && state.entropyPoolVersion > locals.recentMinerA.lastEntropyVersion)
-								)
-							{
-								locals.recentMinerA.minerId = qpi.invocator();
-								locals.recentMinerA.deposit = locals.cmt.amount;
-								locals.recentMinerA.lastEntropyVersion = state.entropyPoolVersion;
-								locals.recentMinerA.lastRevealTick = locals.currentTick;
-								state.recentMiners.set(locals.lowestIx, locals.recentMinerA);
-							}
-						}
-					}
+		// One pool update and one recentMiners update for all successful reveals
+		if (output.revealedCount > 0)
+		{
+			state.currentEntropyPool.u64._0 ^= locals.poolDelta.u64._0;
+			state.currentEntropyPool.u64._1 ^= locals.poolDelta.u64._1;
+			state.currentEntropyPool.u64._2 ^= locals.poolDelta.u64._2;
+			state.currentEntropyPool.u64._3 ^= locals.poolDelta.u64._3;
+			state.pendingRevealCount++;
+
+			qpi.transfer(qpi.invocator(), output.depositReturned);
+			locals.recordInput.minerId = qpi.invocator();
+			locals.recordInput.depositTier = locals.bestDepositTier;
+			CALL(RecordRecentMiner, locals.recordInput, locals.recordOutput);
+		}
 
-					// Remove commitment (swap with last) and continue scanning without incrementing i.
-					state.totalSecurityDepositsLocked -= locals.cmt.amount;
-					if (locals.i != state.commitmentCount - 1)
-					{
-						locals.cmt = state.commitments.get(state.commitmentCount - 1);
-						state.commitments.set(locals.i, locals.cmt);
-					}
-					state.commitmentCount--;
-					continue;
-				}
+		// New commitments share the invocation reward evenly; refund it if any share is not acceptable
+		locals.newCommitCount = 0;
+		for (locals.flow = 0; locals.flow < input.flowCount; ++locals.flow)
+		{
+			if (!isZeroIdCheck(input.committedDigests.get(locals.flow)))
+			{
+				locals.newCommitCount++;
 			}
-			locals.i++;
 		}
-
-		// If caller provided a new commitment (invocationReward used as deposit) and not stopping mining,
-		// accept it if deposit is valid and meets minimum.
-		if (locals.hasNewCommit && !locals.isStoppingMining)
+		if (locals.newCommitCount > 0 && qpi.invocationReward() > 0)
 		{
-			// Inline deposit validity check using allowed-values array
-			locals.depositValid = false;
-			for (locals.i = 0; locals.i < RANDOM_VALID_DEPOSIT_AMOUNTS; ++locals.i)
+			locals.share = div((uint64)qpi.invocationReward(), (uint64)locals.newCommitCount);
+			if (!isValidDeposit(state, locals.share) || locals.share * locals.newCommitCount != (uint64)qpi.invocationReward() ||
+				locals.share < state.minimumSecurityDeposit || state.commitmentCount + locals.newCommitCount > RANDOM_MAX_COMMITMENTS)
 			{
-				if (validDepositAmountAt(state, qpi.invocationReward(), locals.i))
+				if (state.commitmentCount + locals.newCommitCount > RANDOM_MAX_COMMITMENTS)
 				{
-					locals.depositValid = true;
-					break;
+					state.perf.commitsRejectedByCapacity += locals.newCommitCount;
 				}
+				qpi.transfer(qpi.invocator(), qpi.invocationReward());
+				state.perf.refundsIssued++;
 			}
-
-			if (locals.depositValid && qpi.invocationReward() >= state.minimumSecurityDeposit)
+			else
 			{
-				if (state.commitmentCount < RANDOM_MAX_COMMITMENTS)
+				for (locals.flow = 0; locals.flow < input.flowCount; ++locals.flow)
 				{
-					// Use locals.ncmt (approved locals) as temporary to avoid stack-local.
-					locals.ncmt.digest = input.committedDigest;
-					locals.ncmt.invocatorId = qpi.invocator();
-					locals.ncmt.amount = qpi.invocationReward();
-					locals.ncmt.commitTick = locals.currentTick;
-					locals.ncmt.revealDeadlineTick = locals.currentTick + state.revealTimeoutTicks;
-					locals.ncmt.hasRevealed = false;
-					state.commitments.set(state.commitmentCount, locals.ncmt);
-					state.commitmentCount++;
-					state.totalCommits++;
-					state.totalSecurityDepositsLocked += qpi.invocationReward();
-					output.commitSuccessful = true;
+					if (!isZeroIdCheck(input.committedDigests.get(locals.flow)))
+					{
+						locals.addInput.digest = input.committedDigests.get(locals.flow);
+						locals.addInput.invocatorId = qpi.invocator();
+						locals.addInput.depositTier = uint8(RANDOM_DepositTiers::floorTier(locals.share));
+						CALL(AddCommitment, locals.addInput, locals.addOutput);
+						output.committedCount += locals.addOutput.success;
+					}
 				}
 			}
 		}
-
-		// Produce 32 random-like bytes from latest entropy history and current tick:
-		// - take most recent history entry (histIdx) and extract bytes from its 64-bit lanes,
-		// - XOR first 8 bytes with tick-derived bytes to add per-tick variation.
-		locals.histIdx = (state.entropyHistoryHead + RANDOM_ENTROPY_HISTORY_LEN - 0) & (RANDOM_ENTROPY_HISTORY_LEN - 1);
-		for (locals.rb_i = 0; locals.rb_i < RANDOM_RANDOMBYTES_LEN; ++locals.rb_i)
+		else if (qpi.invocationReward() > 0)
 		{
-			// Extract the correct 64-bit lane and then the requested byte without using plain [].
-			output.randomBytes.set(
-				locals.rb_i,
-				static_cast<uint8_t>(
-					(
-						(
-							(locals.rb_i < 8) ? state.entropyHistory.get(locals.histIdx).u64._0 :
-							(locals.rb_i < 16) ? state.entropyHistory.get(locals.histIdx).u64._1 :
-							(locals.rb_i < 24) ? state.entropyHistory.get(locals.histIdx).u64._2 :
-							state.entropyHistory.get(locals.histIdx).u64._3
-							) >> (8 * (locals.rb_i & 7))
-						) & 0xFF
-					) ^
-				(locals.rb_i < 8 ? static_cast<uint8_t>((static_cast<uint64_t>(locals.currentTick) >> (8 * locals.rb_i)) & 0xFF) : 0)
-			);
+			qpi.transfer(qpi.invocator(), qpi.invocationReward());
+			state.perf.refundsIssued++;
 		}
 
 		output.entropyVersion = state.entropyPoolVersion;
 	}
 
 	// BuyEntropy procedure:
-	// - Removes expired commitments (same sweep)
 	// - Checks buyer fee and miner eligibility
 	// - Charges buyer and returns requested bytes from slightly older pool version
 	PUBLIC_PROCEDURE_WITH_LOCALS(BuyEntropy)
 	{
 	    locals.currentTick = qpi.tick();
 	
-	    // Sweep expired commitments
-	    for (locals.i = 0; locals.i < state.commitmentCount;)
-	    {
-	        locals.cmt = state.commitments.get(locals.i);
-	        if (!locals.cmt.hasRevealed && locals.currentTick > locals.cmt.revealDeadlineTick)
-	        {
-	            locals.lostDeposit = locals.cmt.amount;
-	            state.lostDepositsRevenue += locals.lostDeposit;
-	            state.totalRevenue += locals.lostDeposit;
-	            state.pendingShareholderDistribution += locals.lostDeposit;
-	            state.totalSecurityDepositsLocked -= locals.lostDeposit;
-	            if (locals.i != state.commitmentCount - 1)
-	            {
-	                locals.cmt = state.commitments.get(state.commitmentCount - 1);
-	                state.commitments.set(locals.i, locals.cmt);
-	            }
-	            state.commitmentCount--;
-	        }
-	        else
-	        {
-	            locals.i++;
-	        }
-	    }
-	
-	    // Disallow in early-epoch mode -- refund buyer
-	    if (qpi.numberOfTickTransactions() == -1)
-	    {
-	        output.success = false;
-	        qpi.transfer(qpi.invocator(), qpi.invocationReward()); // <-- refund buyer
-	        return;
-	    }
-	
 	    output.success = false;
-	    locals.buyerFee = qpi.invocationReward();
-	    locals.eligible = false;
-	    locals.usedMinerDeposit = 0;
-	
-	    // Find an eligible recent miner whose deposit >= minMinerDeposit and who revealed recently
-	    for (locals.i = 0; locals.i < state.recentMinerCount; ++locals.i)
-	    {
-	        locals.recentMinerTemp = state.recentMiners.get(locals.i);
-	        if (locals.recentMinerTemp.deposit >= input.minMinerDeposit &&
-	            (locals.currentTick - locals.recentMinerTemp.lastRevealTick) <= state.revealTimeoutTicks)
-	        {
-	            locals.eligible = true;
-	            locals.usedMinerDeposit = locals.recentMinerTemp.deposit;
-	            break;
-	        }
-	    }
-	
-	    if (!locals.eligible)
+	    locals.chargeInput.numberOfBytes = input.numberOfBytes;
+	    locals.chargeInput.minMinerDeposit = input.minMinerDeposit;
+	    locals.chargeInput.entropyVersion = input.entropyVersion;
+	    locals.chargeInput.usePrepaid = input.usePrepaid;
+	    CALL(ChargeEntropyPurchase, locals.chargeInput, locals.chargeOutput);
+	    if (!locals.chargeOutput.success)
 	    {
-	        qpi.transfer(qpi.invocator(), qpi.invocationReward()); // <-- refund buyer (no entropy available)
 	        return;
 	    }
 	
-	    // Compute minimum price and check buyer fee
-        locals.minPrice = calculatePrice(state, input.numberOfBytes, input.minMinerDeposit);
-	
-	    if (locals.buyerFee < locals.minPrice)
-	    {
-	        qpi.transfer(qpi.invocator(), qpi.invocationReward()); // <-- refund buyer (not enough fee)
-	        return;
-	    }
-	
-	    // Use the previous-but-one history entry for purchased entropy (to avoid last-second reveals)
-	    locals.histIdx = (state.entropyHistoryHead + RANDOM_ENTROPY_HISTORY_LEN - 2) & (RANDOM_ENTROPY_HISTORY_LEN - 1);
+	    // History slot chosen by ChargeEntropyPurchase (previous-but-one version unless a version was requested)
+	    locals.histIdx = locals.chargeOutput.historySlot;
 	
 	    // Produce requested bytes (bounded by RANDOM_RANDOMBYTES_LEN)
 	    for (locals.i = 0; locals.i < ((input.numberOfBytes > RANDOM_RANDOMBYTES_LEN) ? RANDOM_RANDOMBYTES_LEN : input.numberOfBytes); ++locals.i)
@@ -607,21 +2001,149 @@ public:
 	
 	    // Return entropy pool/version info and signal success
 	    output.entropyVersion = state.entropyPoolVersionHistory.get(locals.histIdx);
-	    output.usedMinerDeposit = locals.usedMinerDeposit;
+	    output.usedMinerDeposit = locals.chargeOutput.usedMinerDeposit;
 	    output.usedPoolVersion = state.entropyPoolVersionHistory.get(locals.histIdx);
 	    output.success = true;
-	
-	    // Split fee: half to miners pool, half to shareholders
-	    locals.half = div(locals.buyerFee, 2ULL);
-	    state.minerEarningsPool += locals.half;
-	    state.shareholderEarningsPool += (locals.buyerFee - locals.half);
 	}
 
-	// GetContractInfo: return public state summary
+	// BuyEntropyBulk procedure:
+	// - Same eligibility, pricing and pool selection as BuyEntropy, for up to RANDOM_BULK_RANDOMBYTES_LEN bytes
+	// - Expands the selected pool in counter mode: block j = K12(pool, buyer, tick, domain, j)
+	PUBLIC_PROCEDURE_WITH_LOCALS(BuyEntropyBulk)
+	{
+		output.success = false;
+		if (input.numberOfBytes == 0 || input.numberOfBytes > RANDOM_BULK_RANDOMBYTES_LEN)
+		{
+			if (qpi.invocationReward() > 0)
+			{
+				qpi.transfer(qpi.invocator(), qpi.invocationReward()); // <-- refund buyer (invalid size)
+				state.perf.refundsIssued++;
+			}
+			return;
+		}
+
+		locals.chargeInput.numberOfBytes = input.numberOfBytes;
+		locals.chargeInput.minMinerDeposit = input.minMinerDeposit;
+		locals.chargeInput.entropyVersion = input.entropyVersion;
+		locals.chargeInput.usePrepaid = input.usePrepaid;
+		CALL(ChargeEntropyPurchase, locals.chargeInput, locals.chargeOutput);
+		if (!locals.chargeOutput.success)
+		{
+			return;
+		}
+
+		// Same pool selection as BuyEntropy
+		locals.histIdx = locals.chargeOutput.historySlot;
+		locals.expansion.pool = state.entropyHistory.get(locals.histIdx);
+		locals.expansion.buyerId = qpi.invocator();
+		locals.expansion.domain = RANDOM_BULK_EXPANSION_DOMAIN;
+		locals.expansion.tick = qpi.tick();
+
+		for (locals.i = 0; locals.i < input.numberOfBytes; ++locals.i)
+		{
+			if ((locals.i & 31) == 0)
+			{
+				locals.expansion.blockIndex = (locals.i >> 5);
+				locals.block = qpi.K12(locals.expansion);
+			}
+			output.randomBytes.set(
+				locals.i,
+				static_cast<uint8_t>(
+					(
+						((locals.i & 31) < 8)  ? locals.block.u64._0 :
+						((locals.i & 31) < 16) ? locals.block.u64._1 :
+						((locals.i & 31) < 24) ? locals.block.u64._2 :
+						                         locals.block.u64._3
+					) >> (8 * (locals.i & 7))
+				)
+			);
+		}
+
+		output.entropyVersion = state.entropyPoolVersionHistory.get(locals.histIdx);
+		output.usedMinerDeposit = locals.chargeOutput.usedMinerDeposit;
+		output.usedPoolVersion = state.entropyPoolVersionHistory.get(locals.histIdx);
+		output.success = true;
+	}
+
+	// ClaimEarnings: pay the invocator's accrued miner earnings (current or earlier epochs)
+	PUBLIC_PROCEDURE_WITH_LOCALS(ClaimEarnings)
+	{
+		if (qpi.invocationReward() > 0)
+		{
+			qpi.transfer(qpi.invocator(), qpi.invocationReward());
+			state.perf.refundsIssued++;
+		}
+
+		locals.minerIx = state.recentMinerSlots.getElementIndex(qpi.invocator());
+		state.perf.recentMinerLookups++;
+		if (locals.minerIx < 0)
+		{
+			return;
+		}
+		locals.payInput.slot = state.recentMinerSlots.value(locals.minerIx);
+		CALL(PayRecentMiner, locals.payInput, locals.payOutput);
+		output.amount = locals.payOutput.amount;
+	}
+
+	// DepositPrepaid: credit the invocation reward to the invocator's prepaid balance
+	PUBLIC_PROCEDURE_WITH_LOCALS(DepositPrepaid)
+	{
+		output.success = false;
+		locals.balanceIx = state.prepaidBalances.getElementIndex(qpi.invocator());
+		output.balance = (locals.balanceIx < 0) ? 0 : state.prepaidBalances.value(locals.balanceIx);
+		if (qpi.invocationReward() <= 0)
+		{
+			return;
+		}
+
+		if (locals.balanceIx >= 0 || state.prepaidBalances.population() < RANDOM_MAX_PREPAID_BUYERS)
+		{
+			locals.balanceIx = state.prepaidBalances.set(qpi.invocator(), output.balance + qpi.invocationReward());
+		}
+		if (locals.balanceIx < 0)
+		{
+			qpi.transfer(qpi.invocator(), qpi.invocationReward()); // <-- refund (no balance slot free)
+			state.perf.refundsIssued++;
+			return;
+		}
+		state.totalPrepaidBalance += qpi.invocationReward();
+		output.balance += qpi.invocationReward();
+		output.success = true;
+	}
+
+	// WithdrawPrepaid: pay out up to the requested amount (0 = everything) of the invocator's prepaid balance
+	PUBLIC_PROCEDURE_WITH_LOCALS(WithdrawPrepaid)
+	{
+		if (qpi.invocationReward() > 0)
+		{
+			qpi.transfer(qpi.invocator(), qpi.invocationReward());
+			state.perf.refundsIssued++;
+		}
+
+		locals.balanceIx = state.prepaidBalances.getElementIndex(qpi.invocator());
+		if (locals.balanceIx < 0)
+		{
+			return;
+		}
+		output.balance = state.prepaidBalances.value(locals.balanceIx);
+		output.withdrawn = (input.amount == 0 || input.amount > output.balance) ? output.balance : input.amount;
+		output.balance -= output.withdrawn;
+		if (output.balance == 0)
+		{
+			state.prepaidBalances.removeByIndex(locals.balanceIx);
+		}
+		else
+		{
+			state.prepaidBalances.set(qpi.invocator(), output.balance);
+		}
+		state.totalPrepaidBalance -= output.withdrawn;
+		qpi.transfer(qpi.invocator(), output.withdrawn);
+	}
+
+	// GetContractInfo: return public state summary (constant time, from counters kept by the mutation sites)
 	PUBLIC_FUNCTION_WITH_LOCALS(GetContractInfo)
 	{
 		locals.currentTick = qpi.tick();
-		locals.activeCount = 0;
 
 		output.totalCommits = state.totalCommits;
 		output.totalReveals = state.totalReveals;
@@ -637,41 +2159,125 @@ public:
 		output.minerEarningsPool = state.minerEarningsPool;
 		output.shareholderEarningsPool = state.shareholderEarningsPool;
 		output.recentMinerCount = state.recentMinerCount;
+		output.totalForfeitedCommitments = state.totalForfeitedCommitments;
+		output.totalRefundedCommitments = state.totalRefundedCommitments;
+		output.totalPrepaidBalance = state.totalPrepaidBalance;
 
 		// Copy valid deposit amounts
 		copyMemory(output.validDepositAmounts, state.validDepositAmounts);
-		
-		// Count active commitments
-		for (locals.i = 0; locals.i < state.commitmentCount; ++locals.i)
-		{
-			if (!state.commitments.get(locals.i).hasRevealed)
-			{
-				locals.activeCount++;
-			}
-		}
-		output.activeCommitments = locals.activeCount;
+
+		// Opened, forfeited and refunded commitments are removed at once, so every stored one is active
+		output.activeCommitments = state.commitmentCount;
+	}
+
+	// GetPerfCounters: cumulative hot-loop work counters plus current occupancy
+	PUBLIC_FUNCTION(GetPerfCounters)
+	{
+		output.counters = state.perf;
+		output.activeCommitments = state.commitmentCount;
+		output.recentMinerCount = state.recentMinerCount;
+		output.currentTick = qpi.tick();
 	}
 
-	// GetUserCommitments: list commitments for a user (bounded)
+	// GetUserCommitments: list commitments for a user (bounded), newest first via the owner index
 	PUBLIC_FUNCTION_WITH_LOCALS(GetUserCommitments)
 	{
 		locals.userCommitmentCount = 0;
-		for (locals.i = 0; locals.i < state.commitmentCount && locals.userCommitmentCount < RANDOM_MAX_USER_COMMITMENTS; ++locals.i)
+		locals.ownerIx = state.commitmentOwners.getElementIndex(input.userId);
+		locals.i = (locals.ownerIx < 0) ? RANDOM_INVALID_SLOT : state.commitmentOwners.value(locals.ownerIx);
+		while (locals.i != RANDOM_INVALID_SLOT && locals.userCommitmentCount < RANDOM_MAX_USER_COMMITMENTS)
+		{
+			// copy to output buffer; stored commitments are never revealed ones
+			locals.ucmt.digest = state.commitmentDigests.get(locals.i);
+			locals.ucmt.amount = commitmentDeposit(state, locals.i);
+			locals.ucmt.commitTick = state.commitmentCommitTicks.get(locals.i);
+			locals.ucmt.revealDeadlineTick = state.commitmentDeadlines.get(locals.i);
+			locals.ucmt.hasRevealed = false;
+			output.commitments.set(locals.userCommitmentCount, locals.ucmt);
+			locals.userCommitmentCount++;
+
+			locals.i = state.commitmentOwnerNext.get(locals.i);
+		}
+		output.commitmentCount = locals.userCommitmentCount;
+	}
+
+	// GetCommitmentsPage: up to RANDOM_SNAPSHOT_PAGE_LEN stored commitments starting at slot cursor
+	PUBLIC_FUNCTION_WITH_LOCALS(GetCommitmentsPage)
+	{
+		output.totalCount = state.commitmentCount;
+		output.stateVersion = state.stateVersion;
+		for (locals.slot = input.cursor; locals.slot < state.commitmentCount && output.count < RANDOM_SNAPSHOT_PAGE_LEN; ++locals.slot)
+		{
+			locals.record.digest = state.commitmentDigests.get(locals.slot);
+			locals.record.invocatorId = state.commitmentInvocators.get(locals.slot);
+			locals.record.amount = commitmentDeposit(state, locals.slot);
+			locals.record.commitTick = state.commitmentCommitTicks.get(locals.slot);
+			locals.record.revealDeadlineTick = state.commitmentDeadlines.get(locals.slot);
+			output.commitments.set(output.count, locals.record);
+			output.count++;
+		}
+		output.nextCursor = (locals.slot < state.commitmentCount) ? locals.slot : 0;
+	}
+
+	// GetRecentMinersPage: occupied recentMiners slots from cursor on, densely packed. Empty slots are
+	// skipped, but at most 4 * RANDOM_SNAPSHOT_PAGE_LEN slots are scanned per call.
+	PUBLIC_FUNCTION_WITH_LOCALS(GetRecentMinersPage)
+	{
+		output.recentMinerCount = state.recentMinerCount;
+		output.recentMinerGeneration = state.recentMinerGeneration;
+		output.rewardPerWeight = state.rewardPerWeight;
+		output.stateVersion = state.stateVersion;
+		for (locals.slot = input.cursor;
+			locals.slot < RANDOM_MAX_RECENT_MINERS && output.count < RANDOM_SNAPSHOT_PAGE_LEN && locals.scanned < 4 * RANDOM_SNAPSHOT_PAGE_LEN;
+			++locals.slot)
 		{
-			locals.cmt = state.commitments.get(locals.i);
-			if (isEqualIdCheck(locals.cmt.invocatorId, input.userId))
+			locals.scanned++;
+			if (!isZeroIdCheck(state.recentMiners.get(locals.slot).minerId))
 			{
-				// copy to output buffer
-				locals.ucmt.digest = locals.cmt.digest;
-				locals.ucmt.amount = locals.cmt.amount;
-				locals.ucmt.commitTick = locals.cmt.commitTick;
-				locals.ucmt.revealDeadlineTick = locals.cmt.revealDeadlineTick;
-				locals.ucmt.hasRevealed = locals.cmt.hasRevealed;
-				output.commitments.set(locals.userCommitmentCount, locals.ucmt);
-				locals.userCommitmentCount++;
+				output.miners.set(output.count, state.recentMiners.get(locals.slot));
+				output.count++;
 			}
 		}
-		output.commitmentCount = locals.userCommitmentCount;
+		output.nextCursor = (locals.slot < RANDOM_MAX_RECENT_MINERS) ? locals.slot : 0;
+	}
+
+	// GetEventsSince: up to RANDOM_EVENT_PAGE_LEN events starting at input.seq (or the oldest one kept)
+	PUBLIC_FUNCTION_WITH_LOCALS(GetEventsSince)
+	{
+		output.oldestSeq = (state.eventCount > RANDOM_EVENT_RING_LEN) ? state.eventCount - RANDOM_EVENT_RING_LEN : 0;
+		output.missedEvents = (input.seq < output.oldestSeq);
+		for (locals.seq = output.missedEvents ? output.oldestSeq : input.seq;
+			locals.seq < state.eventCount && output.count < RANDOM_EVENT_PAGE_LEN;
+			++locals.seq)
+		{
+			output.events.set(output.count, state.events.get(locals.seq & (RANDOM_EVENT_RING_LEN - 1)));
+			output.count++;
+		}
+		output.nextSeq = (locals.seq > input.seq) ? locals.seq : input.seq;
+	}
+
+	// GetEntropyAtVersion: pool recorded for a past version, for audit and deterministic replay.
+	// Only versions older than the default buy version are served.
+	PUBLIC_FUNCTION(GetEntropyAtVersion)
+	{
+		output.found = false;
+		output.newestBuyableVersion = (state.entropyPoolVersion < RANDOM_BUY_VERSION_LAG) ? 0 : state.entropyPoolVersion - RANDOM_BUY_VERSION_LAG;
+		output.oldestVersion = (state.entropyPoolVersion < RANDOM_ENTROPY_HISTORY_LEN - 1) ? 0 : state.entropyPoolVersion - (RANDOM_ENTROPY_HISTORY_LEN - 1);
+		if (input.entropyVersion < output.oldestVersion || input.entropyVersion >= output.newestBuyableVersion ||
+			state.entropyPoolVersionHistory.get(input.entropyVersion & (RANDOM_ENTROPY_HISTORY_LEN - 1)) != input.entropyVersion)
+		{
+			return;
+		}
+		output.found = true;
+		output.entropyPool = state.entropyHistory.get(input.entropyVersion & (RANDOM_ENTROPY_HISTORY_LEN - 1));
+		output.tick = state.entropyHistoryTick.get(input.entropyVersion & (RANDOM_ENTROPY_HISTORY_LEN - 1));
+	}
+
+	// GetPrepaidBalance: prepaid balance of a buyer (0 if none)
+	PUBLIC_FUNCTION_WITH_LOCALS(GetPrepaidBalance)
+	{
+		locals.balanceIx = state.prepaidBalances.getElementIndex(input.buyerId);
+		output.balance = (locals.balanceIx < 0) ? 0 : state.prepaidBalances.value(locals.balanceIx);
 	}
 
 	// QueryPrice: compute price for a buyer based on requested bytes and min miner deposit
@@ -680,59 +2286,75 @@ public:
 		output.price = calculatePrice(state, input.numberOfBytes, input.minMinerDeposit);
 	}
 
-	// END_EPOCH: sweep expired commitments and distribute earnings to recent miners and shareholders
-	END_EPOCH_WITH_LOCALS()
+	// GetAvailableSecurity: BuyEntropy eligibility per deposit tier, so buyers can skip doomed purchases
+	PUBLIC_FUNCTION_WITH_LOCALS(GetAvailableSecurity)
 	{
-		locals.currentTick = qpi.tick();
-
-		// Sweep expired commitments (same logic)
-		for (locals.i = 0; locals.i < state.commitmentCount;)
+		output.currentTick = qpi.tick();
+		for (locals.tier = 0; locals.tier < RANDOM_VALID_DEPOSIT_AMOUNTS; ++locals.tier)
 		{
-			locals.cmt = state.commitments.get(locals.i);
-			if (!locals.cmt.hasRevealed && locals.currentTick > locals.cmt.revealDeadlineTick)
-			{
-				locals.lostDeposit = locals.cmt.amount;
-				state.lostDepositsRevenue += locals.lostDeposit;
-				state.totalRevenue += locals.lostDeposit;
-				state.pendingShareholderDistribution += locals.lostDeposit;
-				state.totalSecurityDepositsLocked -= locals.lostDeposit;
-
-				if (locals.i != state.commitmentCount - 1)
-				{
-					locals.cmt = state.commitments.get(state.commitmentCount - 1);
-					state.commitments.set(locals.i, locals.cmt);
-				}
-				state.commitmentCount--;
-			}
-			else
+			output.validDepositAmounts.set(locals.tier, state.validDepositAmounts.get(locals.tier));
+			locals.freshness = state.freshestRevealAtTier.get(locals.tier);
+			if (!locals.freshness.hasReveal)
 			{
-				locals.i++;
+				continue;
 			}
+			// Same test as ChargeEntropyPurchase: stale once currentTick - lastRevealTick > revealTimeoutTicks
+			output.staleAtTick.set(locals.tier, locals.freshness.lastRevealTick + state.revealTimeoutTicks + 1);
+			output.revealerDeposit.set(locals.tier, locals.freshness.revealerDeposit);
+			output.available.set(locals.tier, (output.currentTick - locals.freshness.lastRevealTick) <= state.revealTimeoutTicks);
 		}
+	}
 
-		// Pay miners equally from minerEarningsPool
-		if (state.minerEarningsPool > 0 && state.recentMinerCount > 0)
+	// QueryPriceMatrix: prices of every (numberOfBytes, deposit tier) pair, for client-side caching
+	PUBLIC_FUNCTION_WITH_LOCALS(QueryPriceMatrix)
+	{
+		for (locals.tier = 0; locals.tier < RANDOM_VALID_DEPOSIT_AMOUNTS; ++locals.tier)
 		{
-			locals.payout = div(state.minerEarningsPool, (uint64)state.recentMinerCount);
-			for (locals.i = 0; locals.i < state.recentMinerCount; ++locals.i)
+			output.validDepositAmounts.set(locals.tier, state.validDepositAmounts.get(locals.tier));
+			for (locals.numberOfBytes = 1; locals.numberOfBytes <= RANDOM_RANDOMBYTES_LEN; ++locals.numberOfBytes)
 			{
-				locals.recentMinerTemp = state.recentMiners.get(locals.i);
-				if (!isZeroIdCheck(locals.recentMinerTemp.minerId))
-				{
-					qpi.transfer(locals.recentMinerTemp.minerId, locals.payout);
-				}
+				output.prices.set((locals.numberOfBytes - 1) * RANDOM_VALID_DEPOSIT_AMOUNTS + locals.tier,
+					calculatePrice(state, locals.numberOfBytes, state.validDepositAmounts.get(locals.tier)));
 			}
-			// reset miner pool and recentMiners
-			state.minerEarningsPool = 0;
-			for (locals.i = 0; locals.i < RANDOM_MAX_RECENT_MINERS; ++locals.i)
+		}
+	}
+
+	// END_EPOCH: close the miner generation and distribute earnings to shareholders
+	// (expired commitments are forfeited by BEGIN_TICK)
+	END_EPOCH_WITH_LOCALS()
+	{
+		locals.currentTick = qpi.tick();
+
+		// Close the miner generation: its entries stop earning and stay claimable against the closing
+		// rewardPerWeight. No per-slot rewrite; slots are reused lazily by the next epoch's miners.
+		state.generationClosingReward.set(state.recentMinerGeneration & (RANDOM_REWARD_GENERATIONS - 1), state.rewardPerWeight);
+		state.recentMinerGeneration++;
+		state.recentMinerCount = 0;
+		state.stateVersion++;
+		state.totalMinerWeight = 0;
+		// rewardRemainder is kept: it is part of minerEarningsPool and goes into the next generation's accrual
+		locals.freshness.revealerDeposit = 0;
+		locals.freshness.lastRevealTick = 0;
+		locals.freshness.hasReveal = false;
+		for (locals.i = 0; locals.i < RANDOM_VALID_DEPOSIT_AMOUNTS; ++locals.i)
+		{
+			state.freshestRevealAtTier.set(locals.i, locals.freshness);
+		}
+
+		// Pay out a few stale entries per epoch so every slot is settled before its generation's closing
+		// value leaves the RANDOM_REWARD_GENERATIONS ring
+		for (locals.i = 0; locals.i < RANDOM_STALE_SETTLE_PER_EPOCH; ++locals.i)
+		{
+			locals.recentMinerTemp = state.recentMiners.get(state.staleSettleCursor);
+			if (!isZeroIdCheck(locals.recentMinerTemp.minerId))
 			{
-				locals.recentMinerTemp.minerId = id::zero();
-				locals.recentMinerTemp.deposit = 0;
-				locals.recentMinerTemp.lastEntropyVersion = 0;
-				locals.recentMinerTemp.lastRevealTick = 0;
-				state.recentMiners.set(locals.i, locals.recentMinerTemp);
+				locals.payInput.slot = state.staleSettleCursor;
+				CALL(PayRecentMiner, locals.payInput, locals.payOutput);
+				state.recentMinerSlots.removeByKey(locals.recentMinerTemp.minerId);
+				setMemory(locals.recentMinerTemp, 0);
+				state.recentMiners.set(state.staleSettleCursor, locals.recentMinerTemp);
 			}
-			state.recentMinerCount = 0;
+			state.staleSettleCursor = (state.staleSettleCursor + 1) & (RANDOM_MAX_RECENT_MINERS - 1);
 		}
 
 		// Distribute any pending shareholder distribution (from earnings and/or lost deposits)
@@ -745,39 +2367,84 @@ public:
 		}
 	}
 
+	// BEGIN_TICK: expiry processing, once per tick instead of in every user procedure. On an empty tick
+	// the deposits due this tick are refunded; then every commitment past its deadline is forfeited.
+	BEGIN_TICK_WITH_LOCALS()
+	{
+		if (qpi.numberOfTickTransactions() == -1)
+		{
+			CALL(RefundEmptyTickCommitments, locals.refundInput, locals.refundOutput);
+		}
+		CALL(SweepExpiredCommitments, locals.sweepInput, locals.sweepOutput);
+	}
+
+	// END_TICK: commit the reveals of this tick as one new pool version (no history write without reveals)
+	END_TICK_WITH_LOCALS()
+	{
+		// Rebuild the id maps once removals have marked enough of their slots
+		state.commitmentOwners.cleanupIfNeeded();
+		state.recentMinerSlots.cleanupIfNeeded();
+		state.prepaidBalances.cleanupIfNeeded();
+
+		if (state.pendingRevealCount == 0)
+		{
+			return;
+		}
+		state.entropyPoolVersion++;
+		locals.histIdx = state.entropyPoolVersion & (RANDOM_ENTROPY_HISTORY_LEN - 1);
+		state.entropyHistory.set(locals.histIdx, state.currentEntropyPool);
+		state.entropyPoolVersionHistory.set(locals.histIdx, state.entropyPoolVersion);
+		state.entropyHistoryTick.set(locals.histIdx, qpi.tick());
+		state.pendingRevealCount = 0;
+	}
+
 	// Register functions and procedures (standard QPI boilerplate)
 	REGISTER_USER_FUNCTIONS_AND_PROCEDURES()
 	{
 		REGISTER_USER_FUNCTION(GetContractInfo, 1);
 		REGISTER_USER_FUNCTION(GetUserCommitments, 2);
 		REGISTER_USER_FUNCTION(QueryPrice, 3);
+		REGISTER_USER_FUNCTION(GetEntropyAtVersion, 4);
+		REGISTER_USER_FUNCTION(GetPrepaidBalance, 5);
+		REGISTER_USER_FUNCTION(QueryPriceMatrix, 6);
+		REGISTER_USER_FUNCTION(GetAvailableSecurity, 7);
+		REGISTER_USER_FUNCTION(GetPerfCounters, 8);
+		REGISTER_USER_FUNCTION(GetCommitmentsPage, 9);
+		REGISTER_USER_FUNCTION(GetRecentMinersPage, 10);
+		REGISTER_USER_FUNCTION(GetEventsSince, 11);
 
 		REGISTER_USER_PROCEDURE(RevealAndCommit, 1);
 		REGISTER_USER_PROCEDURE(BuyEntropy, 2);
+		REGISTER_USER_PROCEDURE(BuyEntropyBulk, 3);
+		REGISTER_USER_PROCEDURE(ClaimEarnings, 4);
+		REGISTER_USER_PROCEDURE(RevealAndCommitBatch, 5);
+		REGISTER_USER_PROCEDURE(DepositPrepaid, 6);
+		REGISTER_USER_PROCEDURE(WithdrawPrepaid, 7);
+		REGISTER_USER_PROCEDURE(RevealAndCommitCompact, 8);
+		REGISTER_USER_PROCEDURE(Commit, 9);
+		REGISTER_USER_PROCEDURE(Reveal, 10);
 	}
 
 	// INITIALIZE: set defaults and fill valid deposit amounts array (powers of 10)
 	INITIALIZE_WITH_LOCALS()
 	{
-		locals.i = 0;
-		locals.j = 0;
-		locals.val = 0;
-
-		state.entropyHistoryHead = 0;
 		state.minimumSecurityDeposit = 1;
+
+		// Empty expiry wheel (revealTimeoutTicks must stay below RANDOM_EXPIRY_WHEEL_LEN)
+		for (locals.i = 0; locals.i < RANDOM_EXPIRY_WHEEL_LEN; ++locals.i)
+		{
+			state.expiryWheelHeads.set(locals.i, RANDOM_INVALID_SLOT);
+		}
+		state.expiryWheelTick = 0;
+
 		state.revealTimeoutTicks = 9;
 		state.pricePerByte = 10;
 		state.priceDepositDivisor = 1000;
 
-		// validDepositAmounts: 1, 10, 100, 1000, ...
+		// validDepositAmounts: 1, 10, 100, 1000, ... (amount of each deposit tier)
 		for (locals.i = 0; locals.i < RANDOM_VALID_DEPOSIT_AMOUNTS; ++locals.i)
 		{
-			locals.val = 1ULL;
-			for (locals.j = 0; locals.j < locals.i; ++locals.j)
-			{
-				locals.val *= 10;
-			}
-			state.validDepositAmounts.set(locals.i, locals.val);
+			state.validDepositAmounts.set(locals.i, RANDOM_DepositTiers::amount(locals.i));
 		}
 	}
 };
@@ -130,11 +130,39 @@ void demonstrateThreeFlows() {
     minerCommit(entropyC, zeroCommit, 0);
 }
 
+void demonstrateBatchedFlows() {
+    uint64 deposit = 100000;
+
+    std::cout << "\n=== Three Flows in One Batch Transaction ===" << std::endl;
+    std::vector<Id> seeds(3), digests(3);
+
+    waitUntilTick(30);
+    for (int f = 0; f < 3; ++f) {
+        seeds[f] = generateSeed();
+        digests[f] = hashSeed(seeds[f]);
+    }
+    minerCommitBatch({}, digests, 3 * deposit);
+
+    for (int cycle = 1; cycle <= 3; cycle++) {
+        waitUntilTick(30 + cycle * 3);
+        std::vector<Id> nextSeeds(3);
+        for (int f = 0; f < 3; ++f) {
+            nextSeeds[f] = generateSeed();
+            digests[f] = hashSeed(nextSeeds[f]);
+        }
+        minerCommitBatch(seeds, digests, 3 * deposit);
+        seeds = nextSeeds;
+    }
+
+    waitUntilTick(42);
+    minerCommitBatch(seeds, {}, 0);
+}
+
 void demonstrateBuyEntropyOnce() {
     std::cout << "\n=== Buy Entropy as a Customer ===" << std::endl;
     uint32_t wants = 32;
     uint64 minDep = 100000;
-    uint64 fee = queryPrice(wants, minDep);
+    uint64 fee = lookupPrice(wants, minDep);
     if(!fee) {
         std::cerr << "Failed to get fee quote from contract - skipping buy call." << std::endl;
         return;
@@ -148,6 +176,7 @@ int main() {
         demonstrateExactFlow();
         demonstrateExtendedMining();
         demonstrateThreeFlows();
+        demonstrateBatchedFlows();
         demonstrateBuyEntropyOnce();
         std::cout << "\nAll flows completed!" << std::endl;
     } catch (const std::exception& e) {
@@ -1,5 +1,6 @@
 #include <iostream>
 #include <vector>
+#include <algorithm>
 #include <string>
 #include <cstring>
 #include <cstdlib>
@@ -19,10 +20,22 @@ extern "C" {
 #define TX_TYPE_MINER 1
 #define TX_TYPE_BUY   2
 #define TX_TYPE_QUERYPRICE 3
+#define TX_TYPE_MINER_BATCH 5
+#define TX_TYPE_MINER_COMPACT 8
+#define TX_TYPE_COMMIT 9
+#define TX_TYPE_REVEAL 10
+#define FN_TYPE_PRICE_MATRIX 6
 
 #define EXTRA_DATA_SIZE_MINER 544
-#define EXTRA_DATA_SIZE_BUY   16
+#define EXTRA_DATA_SIZE_BUY   24
 #define EXTRA_DATA_SIZE_PRICE 12
+#define EXTRA_DATA_SIZE_MINER_BATCH 544 // 8 seeds + 8 digests + flow count, padded to 32 bytes
+#define EXTRA_DATA_SIZE_MINER_COMPACT 64 // seed + digest
+#define EXTRA_DATA_SIZE_COMMIT 32
+#define EXTRA_DATA_SIZE_REVEAL 32
+#define MAX_BATCH_FLOWS 8
+#define PRICE_MATRIX_BYTES 32
+#define PRICE_MATRIX_TIERS 16
 #define SEED "yourminerseedhere"
 #define REVEAL_TICKS 9
 
@@ -56,6 +69,20 @@ Bit4096 generateEntropy() {
     return entropy;
 }
 
+// 32-byte seed for a compact or batched flow; the flow commits to hashSeed(seed)
+Id generateSeed() {
+    Id seed;
+    Bit4096 entropy = generateEntropy();
+    std::memcpy(seed.bytes, entropy.data, 32);
+    return seed;
+}
+
+Id hashSeed(const Id& seed) {
+    Id result;
+    KangarooTwelve(seed.bytes, 32, result.bytes, 32, NULL, 0);
+    return result;
+}
+
 Id hashEntropy(const Bit4096& entropy) {
     Id result;
     KangarooTwelve(reinterpret_cast<const unsigned char*>(&entropy), sizeof(entropy), result.bytes, 32, NULL, 0);
@@ -114,6 +141,58 @@ uint64 queryPrice(uint32_t numBytes, uint64 minDeposit) {
     return 0;
 }
 
+// Cached QueryPriceMatrix result; prices depend only on parameters the contract sets at initialization,
+// so one fetch serves every buy.
+struct PriceMatrixCache {
+    bool loaded = false;
+    uint64 prices[PRICE_MATRIX_BYTES * PRICE_MATRIX_TIERS];
+    uint64 depositTiers[PRICE_MATRIX_TIERS];
+};
+PriceMatrixCache priceMatrix;
+
+bool loadPriceMatrix() {
+    std::ostringstream cmd;
+    cmd << "./qubic-cli"
+        << " -nodeip " << NODE_IP
+        << " -nodeport " << NODE_PORT
+        << " -sendcustomfunction " << SC_ID
+        << " " << FN_TYPE_PRICE_MATRIX << " 0";
+
+    FILE* pipe = popen(cmd.str().c_str(), "r");
+    if (!pipe) return false;
+    char buffer[256];
+    std::string output;
+    while (fgets(buffer, sizeof(buffer), pipe) != nullptr) output += buffer;
+    pclose(pipe);
+
+    size_t pricesPos = output.find("prices:");
+    size_t tiersPos = output.find("validDepositAmounts:");
+    if (pricesPos == std::string::npos || tiersPos == std::string::npos) {
+        std::cout << "Unable to parse QueryPriceMatrix output, got: " << output << std::endl;
+        return false;
+    }
+    std::istringstream prices(output.substr(pricesPos + 7));
+    for (int i = 0; i < PRICE_MATRIX_BYTES * PRICE_MATRIX_TIERS; ++i)
+        if (!(prices >> priceMatrix.prices[i])) return false;
+    std::istringstream tiers(output.substr(tiersPos + 20));
+    for (int i = 0; i < PRICE_MATRIX_TIERS; ++i)
+        if (!(tiers >> priceMatrix.depositTiers[i])) return false;
+    priceMatrix.loaded = true;
+    return true;
+}
+
+// Price from the cached matrix when the request is covered by it (deposit equal to a tier amount),
+// otherwise one QueryPrice call
+uint64 lookupPrice(uint32_t numBytes, uint64 minDeposit) {
+    if (!priceMatrix.loaded) loadPriceMatrix();
+    if (priceMatrix.loaded && numBytes >= 1 && numBytes <= PRICE_MATRIX_BYTES) {
+        for (int tier = 0; tier < PRICE_MATRIX_TIERS; ++tier)
+            if (priceMatrix.depositTiers[tier] == minDeposit)
+                return priceMatrix.prices[(numBytes - 1) * PRICE_MATRIX_TIERS + tier];
+    }
+    return queryPrice(numBytes, minDeposit);
+}
+
 void minerCommit(const Bit4096& revealBits, const Id& commitDigest, uint64 deposit) {
     std::ostringstream extra;
     extra << bit4096ToHex(revealBits);
@@ -132,8 +211,78 @@ void minerCommit(const Bit4096& revealBits, const Id& commitDigest, uint64 depos
     else std::cerr << "Commit TX failed\n";
 }
 
+// Compact flow: reveal a 32-byte seed and commit to hashSeed(next seed) (zero seed = nothing to reveal)
+void minerCommitCompact(const Id& revealSeed, const Id& commitDigest, uint64 deposit) {
+    std::ostringstream extra;
+    extra << toHex(revealSeed.bytes, 32);
+    extra << toHex(commitDigest.bytes, 32);
+    std::ostringstream cmd;
+    cmd << "./qubic-cli"
+        << " -nodeip " << NODE_IP
+        << " -nodeport " << NODE_PORT
+        << " -seed " << SEED
+        << " -sendcustomtransaction " << SC_ID
+        << " " << TX_TYPE_MINER_COMPACT << " " << deposit << " " << EXTRA_DATA_SIZE_MINER_COMPACT
+        << " " << extra.str();
+    std::cout << "[Miner] Compact commit: " << cmd.str() << std::endl;
+    int r = system(cmd.str().c_str());
+    if (r == 0) std::cout << "Compact commit TX sent\n";
+    else std::cerr << "Compact commit TX failed\n";
+}
+
+// Single-phase calls: start a flow (digest only) or end it (seed only)
+void sendMinerPhase(int txType, const Id& value, uint64 amount, const char* label) {
+    std::ostringstream cmd;
+    cmd << "./qubic-cli"
+        << " -nodeip " << NODE_IP
+        << " -nodeport " << NODE_PORT
+        << " -seed " << SEED
+        << " -sendcustomtransaction " << SC_ID
+        << " " << txType << " " << amount << " " << (txType == TX_TYPE_COMMIT ? EXTRA_DATA_SIZE_COMMIT : EXTRA_DATA_SIZE_REVEAL)
+        << " " << toHex(value.bytes, 32);
+    std::cout << "[Miner] " << label << ": " << cmd.str() << std::endl;
+    int r = system(cmd.str().c_str());
+    if (r == 0) std::cout << label << " TX sent\n";
+    else std::cerr << label << " TX failed\n";
+}
+
+void minerCommitOnly(const Id& commitDigest, uint64 deposit) {
+    sendMinerPhase(TX_TYPE_COMMIT, commitDigest, deposit, "Commit");
+}
+
+void minerRevealOnly(const Id& revealSeed) {
+    sendMinerPhase(TX_TYPE_REVEAL, revealSeed, 0, "Reveal");
+}
+
+// Reveal and recommit up to MAX_BATCH_FLOWS flows in one transaction; totalDeposit is split evenly
+// over the non-zero commit digests.
+void minerCommitBatch(const std::vector<Id>& revealSeeds, const std::vector<Id>& commitDigests, uint64 totalDeposit) {
+    size_t flows = std::max(revealSeeds.size(), commitDigests.size());
+    std::ostringstream extra;
+    for (size_t i = 0; i < MAX_BATCH_FLOWS; ++i)
+        extra << toHex((i < revealSeeds.size() ? revealSeeds[i] : Id{}).bytes, 32);
+    for (size_t i = 0; i < MAX_BATCH_FLOWS; ++i)
+        extra << toHex((i < commitDigests.size() ? commitDigests[i] : Id{}).bytes, 32);
+    uint32_t flowCount = (uint32_t)flows;
+    extra << toHex(reinterpret_cast<const uint8*>(&flowCount), 4);
+    extra << std::string((EXTRA_DATA_SIZE_MINER_BATCH - 2 * MAX_BATCH_FLOWS * 32 - 4) * 2, '0');
+
+    std::ostringstream cmd;
+    cmd << "./qubic-cli"
+        << " -nodeip " << NODE_IP
+        << " -nodeport " << NODE_PORT
+        << " -seed " << SEED
+        << " -sendcustomtransaction " << SC_ID
+        << " " << TX_TYPE_MINER_BATCH << " " << totalDeposit << " " << EXTRA_DATA_SIZE_MINER_BATCH
+        << " " << extra.str();
+    std::cout << "[Miner] Batch (" << flows << " flows): " << cmd.str() << std::endl;
+    int r = system(cmd.str().c_str());
+    if (r == 0) std::cout << "Batch TX sent\n";
+    else std::cerr << "Batch TX failed\n";
+}
+
 void buyEntropyCli(uint32_t numBytes, uint64 minMinerDeposit) {
-    uint64 fee = queryPrice(numBytes, minMinerDeposit);
+    uint64 fee = lookupPrice(numBytes, minMinerDeposit);
     if (!fee) {
         std::cerr << "Could not get price from contract--aborting buy tx!" << std::endl;
         return;
@@ -144,7 +293,7 @@ void buyEntropyCli(uint32_t numBytes, uint64 minMinerDeposit) {
     extra << std::hex
           << std::setw(8) << std::setfill('0') << numBytes
           << std::setw(16) << minMinerDeposit
-          << std::string((EXTRA_DATA_SIZE_BUY-4-8)*2, '0'); // Pad to 16 bytes
+          << std::string((EXTRA_DATA_SIZE_BUY-4-8)*2, '0'); // Pad to 24 bytes (entropyVersion 0 = default pool)
 
     std::ostringstream cmd;
     cmd << "./qubic-cli"
@@ -193,18 +342,16 @@ int main() {
     int cycle = 0;
 
     while (true) {
-        // --- Commit phase ---
-        Bit4096 commitEntropy = generateEntropy();
-        Id nextDigest = hashEntropy(commitEntropy);
-        Bit4096 zeroReveal = {};
-        minerCommit(zeroReveal, nextDigest, deposit);
+        // --- Commit phase (32-byte transaction) ---
+        Id commitSeed = generateSeed();
+        minerCommitOnly(hashSeed(commitSeed), deposit);
         int commitTick = getCurrentTick();
         int revealTick = commitTick + REVEAL_TICKS;
         std::cout << "Committed at tick: " << commitTick << ", will reveal at tick: " << revealTick << std::endl;
 
         // --- Wait and Reveal phase ---
         waitForTick(revealTick);
-        minerCommit(commitEntropy, Id{}, 0); // reveal previous entropy, no new commit
+        minerRevealOnly(commitSeed); // reveal previous seed, no new commit
 
         std::cout << "Mining cycle " << (++cycle) << " complete.\n";
         std::this_thread::sleep_for(std::chrono::seconds(3));
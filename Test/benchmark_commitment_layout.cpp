@@ -0,0 +1,158 @@
+#define NO_UEFI
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include "contract_testing.h"
+
+// Compares the former array-of-structs commitment layout with the parallel arrays RANDOM now uses,
+// at 1024 entries. Both sides carry every per-commitment field the contract stores, including the
+// expiry and owner list links. Each layout runs the two hot scans: the expiry check (deadlines only)
+// and the reveal match (digests only).
+
+namespace
+{
+	constexpr uint64 N = 1024;
+
+	// Layout of a commitment before the split into parallel arrays
+	struct AosCommitment
+	{
+		id     digest;
+		id     invocatorId;
+		uint64 amount;
+		uint32 commitTick;
+		uint32 revealDeadlineTick;
+		bool   hasRevealed;
+		uint32 expiryNext;
+		uint32 expiryPrev;
+		uint32 ownerNext;
+		uint32 ownerPrev;
+	};
+
+	struct AosCommitments
+	{
+		Array<AosCommitment, N> commitments;
+	};
+
+	struct SoaCommitments
+	{
+		Array<id, N> digests;
+		Array<id, N> invocators;
+		Array<uint8, N> depositTiers;
+		Array<uint32, N> commitTicks;
+		Array<uint32, N> deadlines;
+		Array<uint32, N> expiryNext;
+		Array<uint32, N> expiryPrev;
+		Array<uint32, N> ownerNext;
+		Array<uint32, N> ownerPrev;
+	};
+
+	constexpr int ROUNDS = 2000;
+
+	id digestFor(uint64 i)
+	{
+		return id(i * 0x9E3779B97F4A7C15ULL, i ^ 0xA5A5A5A5A5A5A5A5ULL, i + 17, ~i);
+	}
+
+	template <typename F>
+	double nsPerRound(F&& body)
+	{
+		auto begin = std::chrono::steady_clock::now();
+		for (int r = 0; r < ROUNDS; ++r)
+		{
+			body(r);
+		}
+		auto end = std::chrono::steady_clock::now();
+		return std::chrono::duration<double, std::nano>(end - begin).count() / ROUNDS;
+	}
+
+	void benchmarkCommitmentLayouts()
+	{
+		// Value-initialized (zeroed) and allocated with the alignment of id
+		std::unique_ptr<AosCommitments> aos = std::make_unique<AosCommitments>();
+		std::unique_ptr<SoaCommitments> soa = std::make_unique<SoaCommitments>();
+		for (uint64 i = 0; i < N; ++i)
+		{
+			AosCommitment cmt{};
+			cmt.digest = digestFor(i);
+			cmt.invocatorId = digestFor(i + N);
+			cmt.amount = 1000;
+			cmt.commitTick = uint32(i);
+			cmt.revealDeadlineTick = uint32(i) + 9;
+			cmt.expiryNext = uint32((i + 1) % N);
+			cmt.expiryPrev = uint32((i + N - 1) % N);
+			cmt.ownerNext = cmt.expiryNext;
+			cmt.ownerPrev = cmt.expiryPrev;
+			aos->commitments.set(i, cmt);
+
+			soa->digests.set(i, cmt.digest);
+			soa->invocators.set(i, cmt.invocatorId);
+			soa->depositTiers.set(i, 3); // 1000 QU
+			soa->commitTicks.set(i, cmt.commitTick);
+			soa->deadlines.set(i, cmt.revealDeadlineTick);
+			soa->expiryNext.set(i, cmt.expiryNext);
+			soa->expiryPrev.set(i, cmt.expiryPrev);
+			soa->ownerNext.set(i, cmt.ownerNext);
+			soa->ownerPrev.set(i, cmt.ownerPrev);
+		}
+
+		// Expiry scan: count commitments past their deadline
+		uint64 aosExpired = 0, soaExpired = 0;
+		double aosSweep = nsPerRound([&](int r)
+		{
+			uint32 tick = uint32(r % N);
+			for (uint64 i = 0; i < N; ++i)
+			{
+				AosCommitment cmt = aos->commitments.get(i);
+				aosExpired += (!cmt.hasRevealed && tick > cmt.revealDeadlineTick);
+			}
+		});
+		double soaSweep = nsPerRound([&](int r)
+		{
+			uint32 tick = uint32(r % N);
+			for (uint64 i = 0; i < N; ++i)
+			{
+				soaExpired += (tick > soa->deadlines.get(i));
+			}
+		});
+		EXPECT_EQ(aosExpired, soaExpired);
+
+		// Reveal match: find the slot holding a digest
+		uint64 aosFound = 0, soaFound = 0;
+		double aosMatch = nsPerRound([&](int r)
+		{
+			id wanted = digestFor(uint64(r) % N);
+			for (uint64 i = 0; i < N; ++i)
+			{
+				AosCommitment cmt = aos->commitments.get(i);
+				if (cmt.digest == wanted)
+				{
+					aosFound += i;
+					break;
+				}
+			}
+		});
+		double soaMatch = nsPerRound([&](int r)
+		{
+			id wanted = digestFor(uint64(r) % N);
+			for (uint64 i = 0; i < N; ++i)
+			{
+				if (soa->digests.get(i) == wanted)
+				{
+					soaFound += i;
+					break;
+				}
+			}
+		});
+		EXPECT_EQ(aosFound, soaFound);
+
+		printf("[ BENCH    ] %llu commitments, AoS entry %zu bytes\n", N, sizeof(AosCommitment));
+		printf("[ BENCH    ] expiry scan:  AoS %10.0f ns  SoA %10.0f ns\n", aosSweep, soaSweep);
+		printf("[ BENCH    ] reveal match: AoS %10.0f ns  SoA %10.0f ns\n", aosMatch, soaMatch);
+	}
+}
+
+TEST(ContractRandomBenchmark, CommitmentLayoutAosVsSoa)
+{
+	benchmarkCommitmentLayouts();
+}
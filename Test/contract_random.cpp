@@ -57,6 +57,14 @@ public:
 		return out.success;
 	}
 
+	uint64_t claimEarnings(const id& miner)
+	{
+		RANDOM::ClaimEarnings_input inp{};
+		RANDOM::ClaimEarnings_output out{};
+		invokeUserProcedure(0, 4, inp, out, miner, 0);
+		return out.amount;
+	}
+
 	// Direct call to get price
 	uint64_t queryPrice(uint32_t numBytes, uint64_t minMinerDeposit)
 	{
@@ -68,6 +76,14 @@ public:
 		return o.price;
 	}
 
+	RANDOM::GetContractInfo_output contractInfo()
+	{
+		RANDOM::GetContractInfo_input ci{};
+		RANDOM::GetContractInfo_output co{};
+		callFunction(0, 1, ci, co);
+		return co;
+	}
+
 	// Helper entropy/id for test readability
 	static bit_4096 testBits(uint64_t v) {
 		bit_4096 b{};
@@ -80,6 +96,18 @@ public:
 		for (int i =0; i <32; ++i) d.m256i_u8[i] = uint8_t((base >> (i %8)) + i);
 		return d;
 	}
+	// Distinct for every n (testId repeats after 2^15 values, less than the large capacity profile)
+	static id indexedId(uint64_t n) {
+		id d = id::zero();
+		d.m256i_u64[0] = n;
+		d.m256i_u64[1] = 0x5245444E4158454EULL;
+		return d;
+	}
+	static id k12Id(const id& seed) {
+		id digest = id::zero();
+		KangarooTwelve(&seed, sizeof(seed), &digest, sizeof(digest));
+		return digest;
+	}
 	static id k12Digest(const bit_4096& b) {
 		id digest = id::zero();
 		KangarooTwelve(&b, sizeof(b), &digest, sizeof(digest));
@@ -120,7 +148,7 @@ TEST(ContractRandom, TimeoutsAndRefunds)
 	id miner = ContractTestingRandom::testId(11);
 	bit_4096 bits = ContractTestingRandom::testBits(303);
 
-	random.commit(miner, bits, 2000);
+	random.commit(miner, bits, 1000);
 
 	// Timeout: Advance tick past deadline
 	RANDOM::GetContractInfo_input ci0{};
@@ -129,7 +157,8 @@ TEST(ContractRandom, TimeoutsAndRefunds)
 	int timeoutTick = GET_TICK() + co0.revealTimeoutTicks + 1;
 	SET_TICK(timeoutTick);
 
-	// Trigger timeout (choose any call, including another commit or dummy reveal)
+	// Trigger timeout: expiry is processed once per tick in BEGIN_TICK
+	random.callSystemProcedure(0, BEGIN_TICK);
 	RANDOM::RevealAndCommit_input dummy = {};
 	RANDOM::RevealAndCommit_output out{};
 	random.invokeUserProcedure(0, 1, dummy, out, miner, 0);
@@ -138,7 +167,7 @@ TEST(ContractRandom, TimeoutsAndRefunds)
 	RANDOM::GetContractInfo_output co{};
 	random.callFunction(0, 1, ci, co);
 	EXPECT_EQ(co.activeCommitments, 0);
-	EXPECT_EQ(co.lostDepositsRevenue, 2000);
+	EXPECT_EQ(co.lostDepositsRevenue, 1000);
 }
 
 TEST(ContractRandom, EmptyTickRefund)
@@ -158,6 +187,7 @@ TEST(ContractRandom, EmptyTickRefund)
 	numberTickTransactions = -1;
 
 	// All deadlines expire on an empty tick: refund
+	random.callSystemProcedure(0, BEGIN_TICK);
 	RANDOM::RevealAndCommit_input dummy = {};
 	RANDOM::RevealAndCommit_output out{};
 	random.invokeUserProcedure(0, 1, dummy, out, miner, 0);
@@ -273,10 +303,16 @@ TEST(ContractRandom, EndEpochDistribution)
 	uint64_t price = random.queryPrice(16, 10000);
 	random.buyEntropy(buyer, 16, 10000, price, true);
 
+	// Equal deposits earn equal shares
+	uint64_t minerShare = (price / 2) / 2;
+	EXPECT_EQ(random.claimEarnings(miner1), minerShare);
+	EXPECT_EQ(random.claimEarnings(miner2), minerShare);
+	EXPECT_EQ(random.claimEarnings(miner2), 0);
+
 	// Simulate EndEpoch
 	random.callSystemProcedure(0, END_EPOCH);
 
-	// After epoch, earnings pools should be zeroed and recentMinerCount cleared
+	// After epoch and claims, earnings pools should be zeroed and recentMinerCount cleared
 	RANDOM::GetContractInfo_input ci{};
 	RANDOM::GetContractInfo_output co{};
 	random.callFunction(0, 1, ci, co);
@@ -371,6 +407,7 @@ TEST(ContractRandom, EmptyTickRefund_MultiMiners)
 	int tick = system.tick + co0.revealTimeoutTicks;
 	system.tick = tick;
 	numberTickTransactions = -1;
+	random.callSystemProcedure(0, BEGIN_TICK);
 
 	RANDOM::RevealAndCommit_input dummy = {};
 	RANDOM::RevealAndCommit_output out{};
@@ -387,13 +424,14 @@ TEST(ContractRandom, Timeout_MultiMiners)
 	ContractTestingRandom random;
 	id m1 = random.testId(7777);
 	id m2 = random.testId(8888);
-	random.commit(m1, random.testBits(111), 2000);
-	random.commit(m2, random.testBits(112), 4000);
+	random.commit(m1, random.testBits(111), 1000);
+	random.commit(m2, random.testBits(112), 10000);
 	RANDOM::GetContractInfo_input ci0{};
 	RANDOM::GetContractInfo_output co0{};
 	random.callFunction(0, 1, ci0, co0);
 	int afterTimeout = system.tick + co0.revealTimeoutTicks + 1;
 	system.tick = afterTimeout;
+	random.callSystemProcedure(0, BEGIN_TICK);
 
 	RANDOM::RevealAndCommit_input dummy = {};
 	RANDOM::RevealAndCommit_output out{};
@@ -403,7 +441,39 @@ TEST(ContractRandom, Timeout_MultiMiners)
 	RANDOM::GetContractInfo_output co{};
 	random.callFunction(0, 1, ci, co);
 	EXPECT_EQ(co.activeCommitments, 0);
-	EXPECT_EQ(co.lostDepositsRevenue, 6000);
+	EXPECT_EQ(co.lostDepositsRevenue, 11000);
+}
+
+TEST(ContractRandom, BeginTickExpiresCommitmentsWithoutTransactions)
+{
+	ContractTestingRandom random;
+	id late = random.testId(7781);
+	id stalled = random.testId(7782);
+	const uint32 timeout = random.contractInfo().revealTimeoutTicks;
+
+	// Past its deadline on a tick with transactions: BEGIN_TICK alone forfeits the deposit
+	SET_TICK(100);
+	random.commit(late, random.testBits(113), 1000);
+	EXPECT_EQ(random.contractInfo().totalSecurityDepositsLocked, 1000);
+	SET_TICK(100 + timeout + 1);
+	random.callSystemProcedure(0, BEGIN_TICK);
+	EXPECT_EQ(random.contractInfo().activeCommitments, 0);
+	EXPECT_EQ(random.contractInfo().totalSecurityDepositsLocked, 0);
+	EXPECT_EQ(random.contractInfo().lostDepositsRevenue, 1000);
+	EXPECT_EQ(getBalance(late), 1000);
+
+	// Deadline on an empty tick: BEGIN_TICK alone refunds the deposit
+	SET_TICK(200);
+	random.commit(stalled, random.testBits(114), 10000);
+	EXPECT_EQ(random.contractInfo().totalSecurityDepositsLocked, 10000);
+	SET_TICK(200 + timeout);
+	SET_TICK_IS_EMPTY(true);
+	random.callSystemProcedure(0, BEGIN_TICK);
+	SET_TICK_IS_EMPTY(false);
+	EXPECT_EQ(random.contractInfo().activeCommitments, 0);
+	EXPECT_EQ(random.contractInfo().totalSecurityDepositsLocked, 0);
+	EXPECT_EQ(random.contractInfo().lostDepositsRevenue, 1000);
+	EXPECT_EQ(getBalance(stalled), 20000);
 }
 
 TEST(ContractRandom, MultipleBuyersEpochReset)
@@ -509,3 +579,1242 @@ TEST(ContractRandom, OutOfOrderRevealAndCompaction)
 	random.callFunction(0, 1, ci, co);
 	EXPECT_EQ(co.activeCommitments, 0);
 }
+
+TEST(ContractRandom, ExpiryWheelForfeitsOnlyDueCommitments)
+{
+	ContractTestingRandom random;
+	id m1 = random.testId(4101);
+	id m2 = random.testId(4102);
+	id m3 = random.testId(4103);
+	const uint32 timeout = random.contractInfo().revealTimeoutTicks;
+
+	system.tick = 100;
+	random.commit(m1, random.testBits(41), 1000);
+	system.tick = 103;
+	random.commit(m2, random.testBits(42), 100);
+
+	// Only m1's deadline has passed
+	system.tick = 100 + timeout + 1;
+	random.callSystemProcedure(0, BEGIN_TICK);
+	EXPECT_EQ(random.contractInfo().activeCommitments, 1);
+	EXPECT_EQ(random.contractInfo().lostDepositsRevenue, 1000);
+
+	system.tick = 103 + timeout + 1;
+	random.callSystemProcedure(0, BEGIN_TICK);
+	EXPECT_EQ(random.contractInfo().activeCommitments, 0);
+	EXPECT_EQ(random.contractInfo().lostDepositsRevenue, 1100);
+
+	// A gap longer than the wheel still forfeits everything overdue
+	system.tick = 200;
+	random.commit(m3, random.testBits(43), 10);
+	system.tick = 1000;
+	random.callSystemProcedure(0, BEGIN_TICK);
+	EXPECT_EQ(random.contractInfo().activeCommitments, 0);
+	EXPECT_EQ(random.contractInfo().lostDepositsRevenue, 1110);
+}
+
+TEST(ContractRandom, OwnerIndexSurvivesSwapRemovals)
+{
+	ContractTestingRandom random;
+	const int minerCount = 6;
+	const int flowsPerMiner = 3;
+
+	// Interleave commitments of several miners so removals move other owners' entries
+	for (int f = 0; f < flowsPerMiner; ++f)
+	{
+		for (int m = 0; m < minerCount; ++m)
+		{
+			random.commit(random.testId(6100 + m), random.testBits(61000 + m * 10 + f), 100);
+		}
+	}
+
+	// Reveal every second flow, stopping those flows
+	for (int m = 0; m < minerCount; ++m)
+	{
+		for (int f = 0; f < flowsPerMiner; f += 2)
+		{
+			random.stopMining(random.testId(6100 + m), random.testBits(61000 + m * 10 + f));
+		}
+	}
+
+	EXPECT_EQ(random.contractInfo().activeCommitments, minerCount * (flowsPerMiner - 2));
+	RANDOM::GetUserCommitments_input inp{};
+	RANDOM::GetUserCommitments_output out{};
+	for (int m = 0; m < minerCount; ++m)
+	{
+		inp.userId = random.testId(6100 + m);
+		random.callFunction(0, 2, inp, out);
+		ASSERT_EQ(out.commitmentCount, 1u);
+		EXPECT_EQ(out.commitments.get(0).digest, random.k12Digest(random.testBits(61000 + m * 10 + 1)));
+	}
+
+	// Remaining flows can still be revealed through the index
+	for (int m = 0; m < minerCount; ++m)
+	{
+		random.stopMining(random.testId(6100 + m), random.testBits(61000 + m * 10 + 1));
+		inp.userId = random.testId(6100 + m);
+		random.callFunction(0, 2, inp, out);
+		EXPECT_EQ(out.commitmentCount, 0u);
+	}
+	EXPECT_EQ(random.contractInfo().activeCommitments, 0);
+}
+
+TEST(ContractRandom, RecentMinerHeapEvictsLowestRanked)
+{
+	ContractTestingRandom random;
+	const int maxMiners = RANDOM_MAX_RECENT_MINERS;
+	const int weakMiner = 7;
+
+	for (int i = 0; i < maxMiners; ++i)
+	{
+		uint64 deposit = (i == weakMiner) ? 10 : 100;
+		id miner = random.indexedId(20000 + i);
+		random.commit(miner, random.testBits(30000 + i), deposit);
+		random.revealAndCommit(miner, random.testBits(30000 + i), random.testBits(40000 + i), deposit);
+	}
+	EXPECT_EQ(random.contractInfo().recentMinerCount, maxMiners);
+
+	// A stronger newcomer replaces the single lowest-deposit miner
+	id newcomer = random.indexedId(19999);
+	random.commit(newcomer, random.testBits(31999), 1000);
+	random.revealAndCommit(newcomer, random.testBits(31999), random.testBits(41999), 1000);
+	EXPECT_EQ(random.contractInfo().recentMinerCount, maxMiners);
+
+	// Fee large enough that per-miner shares do not round to the same value
+	id buyer = random.indexedId(19998);
+	EXPECT_TRUE(random.buyEntropy(buyer, 32, 100, 1000ULL * maxMiners, true));
+
+	// The evicted miner earns nothing; the higher deposit tier earns a larger share
+	EXPECT_EQ(random.claimEarnings(random.indexedId(20000 + weakMiner)), 0);
+	uint64 strongShare = random.claimEarnings(random.indexedId(20000 + weakMiner + 1));
+	EXPECT_GT(strongShare, 0);
+	EXPECT_GT(random.claimEarnings(newcomer), strongShare);
+}
+
+TEST(ContractRandom, RecentMinerIndexTracksRepeatRevealsAndReset)
+{
+	ContractTestingRandom random;
+	id minerA = random.testId(7101);
+	id minerB = random.testId(7102);
+	id buyer = random.testId(7103);
+	random.increaseEnergy(minerA, 10000);
+
+	// Repeated reveals by the same miner update one entry
+	random.commit(minerA, random.testBits(1), 100);
+	random.revealAndCommit(minerA, random.testBits(1), random.testBits(2), 100);
+	random.revealAndCommit(minerA, random.testBits(2), random.testBits(3), 1000);
+	random.commit(minerB, random.testBits(11), 100);
+	random.revealAndCommit(minerB, random.testBits(11), random.testBits(12), 100);
+	EXPECT_EQ(random.contractInfo().recentMinerCount, 2);
+
+	// The epoch reset clears the index together with the entries
+	EXPECT_TRUE(random.buyEntropy(buyer, 8, 100, 1000, true));
+	random.callSystemProcedure(0, END_EPOCH);
+	EXPECT_EQ(random.contractInfo().recentMinerCount, 0);
+
+	random.revealAndCommit(minerA, random.testBits(3), random.testBits(4), 1000);
+	random.revealAndCommit(minerA, random.testBits(4), random.testBits(5), 1000);
+	EXPECT_EQ(random.contractInfo().recentMinerCount, 1);
+}
+
+TEST(ContractRandom, BuyEligibilityFollowsFreshestRevealPerTier)
+{
+	ContractTestingRandom random;
+	id lowMiner = random.testId(7201);
+	id highMiner = random.testId(7202);
+	id buyer = random.testId(7203);
+	const uint32 timeout = random.contractInfo().revealTimeoutTicks;
+
+	system.tick = 10;
+	random.commit(highMiner, random.testBits(21), 10000);
+	random.revealAndCommit(highMiner, random.testBits(21), random.testBits(22), 10000);
+	system.tick = 14;
+	random.commit(lowMiner, random.testBits(23), 100);
+	random.revealAndCommit(lowMiner, random.testBits(23), random.testBits(24), 100);
+
+	// A high-deposit reveal also vouches for every lower requirement
+	system.tick = 10 + timeout;
+	random.increaseEnergy(buyer, 100000);
+	RANDOM::BuyEntropy_input inp{};
+	inp.numberOfBytes = 8;
+	inp.minMinerDeposit = 5000;
+	RANDOM::BuyEntropy_output out{};
+	random.invokeUserProcedure(0, 2, inp, out, buyer, random.queryPrice(8, 5000));
+	EXPECT_TRUE(out.success);
+	EXPECT_EQ(out.usedMinerDeposit, 10000);
+
+	inp.minMinerDeposit = 1;
+	random.invokeUserProcedure(0, 2, inp, out, buyer, random.queryPrice(8, 1));
+	EXPECT_TRUE(out.success);
+	EXPECT_EQ(out.usedMinerDeposit, 100);
+
+	// Once the high-deposit reveal is stale only the low tier remains available
+	system.tick = 10 + timeout + 1;
+	EXPECT_FALSE(random.buyEntropy(buyer, 8, 5000, random.queryPrice(8, 5000), false));
+	EXPECT_TRUE(random.buyEntropy(buyer, 8, 100, random.queryPrice(8, 100), true));
+	EXPECT_FALSE(random.buyEntropy(buyer, 8, 1000000000000000000ULL, 1000000, false));
+}
+
+TEST(ContractRandom, BuyEntropyBulkExpandsPool)
+{
+	ContractTestingRandom random;
+	id miner = random.testId(7301);
+	id buyer = random.testId(7302);
+	random.commit(miner, random.testBits(31), 1000);
+	random.revealAndCommit(miner, random.testBits(31), random.testBits(32), 1000);
+
+	RANDOM::BuyEntropyBulk_input inp{};
+	inp.numberOfBytes = RANDOM_BULK_RANDOMBYTES_LEN;
+	inp.minMinerDeposit = 1000;
+	RANDOM::BuyEntropyBulk_output out{};
+	uint64 price = random.queryPrice(RANDOM_BULK_RANDOMBYTES_LEN, 1000);
+	random.increaseEnergy(buyer, price);
+	random.invokeUserProcedure(0, 3, inp, out, buyer, price);
+	EXPECT_TRUE(out.success);
+	EXPECT_EQ(getBalance(buyer), 0);
+
+	// Consecutive 32-byte blocks come from distinct hashes
+	int equalBytes = 0;
+	for (uint32 i = 0; i < 32; ++i)
+	{
+		equalBytes += (out.randomBytes.get(i) == out.randomBytes.get(32 + i));
+	}
+	EXPECT_LT(equalBytes, 32);
+
+	// Oversized and underpaid requests are refunded
+	inp.numberOfBytes = RANDOM_BULK_RANDOMBYTES_LEN + 1;
+	random.increaseEnergy(buyer, price);
+	random.invokeUserProcedure(0, 3, inp, out, buyer, price);
+	EXPECT_FALSE(out.success);
+	EXPECT_EQ(getBalance(buyer), price);
+
+	inp.numberOfBytes = 64;
+	random.invokeUserProcedure(0, 3, inp, out, buyer, random.queryPrice(64, 1000) - 1);
+	EXPECT_FALSE(out.success);
+	EXPECT_EQ(getBalance(buyer), price);
+
+	// Rejections without an attached amount issue no refund
+	RANDOM::GetPerfCounters_input pi{};
+	RANDOM::GetPerfCounters_output po{};
+	random.callFunction(0, 8, pi, po);
+	const uint64 refundsBefore = po.counters.refundsIssued;
+	inp.numberOfBytes = RANDOM_BULK_RANDOMBYTES_LEN + 1;
+	random.invokeUserProcedure(0, 3, inp, out, buyer, 0);
+	inp.numberOfBytes = 64;
+	random.invokeUserProcedure(0, 3, inp, out, buyer, 0);
+	EXPECT_FALSE(out.success);
+	random.callFunction(0, 8, pi, po);
+	EXPECT_EQ(po.counters.refundsIssued, refundsBefore);
+}
+
+TEST(ContractRandom, BuyEntropyTargetsPoolVersion)
+{
+	ContractTestingRandom random;
+	id miner = random.testId(7401);
+	id buyer = random.testId(7402);
+	SET_TICK(100);
+	random.commit(miner, random.testBits(0), 1000);
+	const uint64 latest = RANDOM_ENTROPY_HISTORY_LEN + 6;
+	const uint64 oldest = latest - (RANDOM_ENTROPY_HISTORY_LEN - 1);
+	const uint64 target = latest - RANDOM_ENTROPY_HISTORY_LEN / 2;
+	for (uint64 v = 1; v <= latest; ++v)
+	{
+		SET_TICK(100 + uint32(v));
+		random.revealAndCommit(miner, random.testBits(v - 1), random.testBits(v), 1000);
+		random.callSystemProcedure(0, END_TICK);
+	}
+
+	RANDOM::GetEntropyAtVersion_input gi{};
+	RANDOM::GetEntropyAtVersion_output go{};
+	gi.entropyVersion = latest - 3;
+	random.callFunction(0, 4, gi, go);
+	EXPECT_TRUE(go.found);
+	EXPECT_EQ(go.tick, 100 + latest - 3);
+	EXPECT_EQ(go.newestBuyableVersion, latest - 2);
+	EXPECT_EQ(go.oldestVersion, oldest);
+
+	// The default buy version and anything newer or already overwritten is not served
+	gi.entropyVersion = latest - 2;
+	random.callFunction(0, 4, gi, go);
+	EXPECT_FALSE(go.found);
+	gi.entropyVersion = oldest - 1;
+	random.callFunction(0, 4, gi, go);
+	EXPECT_FALSE(go.found);
+	gi.entropyVersion = oldest;
+	random.callFunction(0, 4, gi, go);
+	EXPECT_TRUE(go.found);
+
+	// A targeted buy returns the pool recorded for that version
+	gi.entropyVersion = target;
+	random.callFunction(0, 4, gi, go);
+	ASSERT_TRUE(go.found);
+	uint64 price = random.queryPrice(32, 1000);
+	RANDOM::BuyEntropy_input inp{};
+	inp.numberOfBytes = 32;
+	inp.minMinerDeposit = 1000;
+	inp.entropyVersion = target;
+	RANDOM::BuyEntropy_output out{};
+	random.increaseEnergy(buyer, price);
+	random.invokeUserProcedure(0, 2, inp, out, buyer, price);
+	EXPECT_TRUE(out.success);
+	EXPECT_EQ(out.usedPoolVersion, target);
+	// The first 8 bytes are mixed with the purchase tick
+	EXPECT_EQ(memcmp(&out.randomBytes.get(8), &go.entropyPool.m256i_u8[8], 24), 0);
+
+	// Versions newer than the default buy version are refunded
+	inp.entropyVersion = latest - 1;
+	random.increaseEnergy(buyer, price);
+	random.invokeUserProcedure(0, 2, inp, out, buyer, price);
+	EXPECT_FALSE(out.success);
+	EXPECT_EQ(getBalance(buyer), (long long)price);
+}
+
+TEST(ContractRandom, ContractInfoCountersFollowEveryMutation)
+{
+	ContractTestingRandom random;
+	id m1 = random.testId(8101);
+	id m2 = random.testId(8102);
+	id m3 = random.testId(8103);
+	const uint32 timeout = random.contractInfo().revealTimeoutTicks;
+
+	system.tick = 100;
+	random.commit(m1, random.testBits(81), 1000);
+	random.commit(m2, random.testBits(82), 100);
+	random.commit(m3, random.testBits(83), 10);
+	RANDOM::GetContractInfo_output co = random.contractInfo();
+	EXPECT_EQ(co.activeCommitments, 3);
+	EXPECT_EQ(co.totalCommits, 3);
+	EXPECT_EQ(co.totalSecurityDepositsLocked, 1110);
+
+	// Successful reveal releases the deposit exactly once
+	system.tick = 102;
+	random.stopMining(m1, random.testBits(81));
+	co = random.contractInfo();
+	EXPECT_EQ(co.activeCommitments, 2);
+	EXPECT_EQ(co.totalReveals, 1);
+	EXPECT_EQ(co.totalSecurityDepositsLocked, 110);
+
+	// Empty deadline tick refunds, later sweep forfeits
+	system.tick = 100 + timeout;
+	SET_TICK_IS_EMPTY(true);
+	random.callSystemProcedure(0, BEGIN_TICK);
+	SET_TICK_IS_EMPTY(false);
+	co = random.contractInfo();
+	EXPECT_EQ(co.activeCommitments, 0);
+	EXPECT_EQ(co.totalRefundedCommitments, 2);
+	EXPECT_EQ(co.totalForfeitedCommitments, 0);
+	EXPECT_EQ(co.totalSecurityDepositsLocked, 0);
+
+	system.tick = 200;
+	random.commit(m2, random.testBits(84), 100);
+	system.tick = 200 + timeout + 1;
+	random.callSystemProcedure(0, BEGIN_TICK);
+	co = random.contractInfo();
+	EXPECT_EQ(co.activeCommitments, 0);
+	EXPECT_EQ(co.totalForfeitedCommitments, 1);
+	EXPECT_EQ(co.totalSecurityDepositsLocked, 0);
+}
+
+TEST(ContractRandom, ClaimEarningsWeightsByDepositTierAcrossEpochs)
+{
+	ContractTestingRandom random;
+	id small = random.testId(9101);
+	id large = random.testId(9102);
+	id buyer = random.testId(9103);
+
+	// Weights: deposit 10 -> tier 1 -> 2, deposit 1000 -> tier 3 -> 4
+	random.commit(small, random.testBits(91), 10);
+	random.revealAndCommit(small, random.testBits(91), random.testBits(92), 10);
+	random.commit(large, random.testBits(93), 1000);
+	random.revealAndCommit(large, random.testBits(93), random.testBits(94), 1000);
+
+	uint64 price = random.queryPrice(32, 10);
+	EXPECT_TRUE(random.buyEntropy(buyer, 32, 10, price, true));
+	uint64 minerHalf = price / 2;
+	EXPECT_EQ(random.claimEarnings(small), minerHalf * 2 / 6);
+	EXPECT_EQ(random.claimEarnings(small), 0);
+
+	// Earnings of a closed epoch are paid on claim or by the bounded settlement at epoch end,
+	// whichever comes first, and stop accruing once the generation is closed
+	EXPECT_TRUE(random.buyEntropy(buyer, 32, 10, price, true));
+	long long smallBalance = getBalance(small);
+	long long largeBalance = getBalance(large);
+	random.callSystemProcedure(0, END_EPOCH);
+	EXPECT_EQ(random.contractInfo().recentMinerCount, 0);
+	random.claimEarnings(large);
+	EXPECT_EQ(getBalance(large) - largeBalance, (long long)(minerHalf * 2 * 4 / 6));
+	EXPECT_EQ(getBalance(small) - smallBalance, (long long)(minerHalf * 2 * 2 / 6 - minerHalf * 2 / 6));
+	EXPECT_LE(random.contractInfo().minerEarningsPool, 1);
+
+	// A returning miner starts a fresh entry in the new generation
+	random.revealAndCommit(small, random.testBits(92), random.testBits(95), 10);
+	EXPECT_EQ(random.contractInfo().recentMinerCount, 1);
+	EXPECT_TRUE(random.buyEntropy(buyer, 32, 10, price, true));
+	EXPECT_EQ(random.claimEarnings(small), minerHalf);
+	EXPECT_EQ(random.claimEarnings(buyer), 0);
+}
+
+TEST(ContractRandom, HugeFeeAccrualIsCappedAndCarried)
+{
+	ContractTestingRandom random;
+	id miner = random.testId(9201);
+	id buyer = random.testId(9202);
+	random.commit(miner, random.testBits(96), 1);
+	random.revealAndCommit(miner, random.testBits(96), random.testBits(97), 1);
+
+	// The whole attached fee is kept; with a single weight-1 miner its half exceeds what one buy may scale
+	const uint64 fee = 3 * RANDOM_MAX_ACCRUAL_PER_WEIGHT;
+	EXPECT_TRUE(random.buyEntropy(buyer, 32, 1, fee, true));
+	EXPECT_EQ(getBalance(buyer), 10000);
+	EXPECT_EQ(random.contractInfo().minerEarningsPool, fee / 2);
+	EXPECT_EQ(random.claimEarnings(miner), RANDOM_MAX_ACCRUAL_PER_WEIGHT);
+
+	// The excess rides on the next accrual
+	uint64 price = random.queryPrice(32, 1);
+	EXPECT_TRUE(random.buyEntropy(buyer, 32, 1, price, true));
+	EXPECT_EQ(random.claimEarnings(miner), fee / 2 - RANDOM_MAX_ACCRUAL_PER_WEIGHT + price / 2);
+	EXPECT_EQ(random.contractInfo().minerEarningsPool, 0);
+}
+
+// Every named capacity profile must satisfy the layout constraints, not only the selected one
+static_assert(RANDOM_CapacityChecks<RANDOM_CapacityMainnet>::ok, "mainnet profile");
+static_assert(RANDOM_CapacityChecks<RANDOM_CapacityTestnet>::ok, "testnet profile");
+static_assert(RANDOM_CapacityChecks<RANDOM_CapacityLarge>::ok, "large profile");
+
+TEST(ContractRandom, CapacityProfileDrivesStateSizes)
+{
+	ContractTestingRandom random;
+	EXPECT_EQ(decltype(RANDOM::BuyEntropy_output::randomBytes)::capacity(), RANDOM_Capacity::randomBytesLen);
+	const uint64 deposit = random.contractInfo().minimumSecurityDeposit;
+	RANDOM::Commit_input ci{};
+	RANDOM::Commit_output co{};
+	RANDOM::Reveal_input ri{};
+	RANDOM::Reveal_output ro{};
+	RANDOM::GetPerfCounters_input pi{};
+	RANDOM::GetPerfCounters_output po{};
+
+	// The commitment arrays hold exactly maxCommitments entries, one per distinct miner
+	SET_TICK(10);
+	for (uint32 i = 0; i < RANDOM_Capacity::maxCommitments; ++i)
+	{
+		id miner = random.indexedId(100000 + i);
+		random.increaseEnergy(miner, deposit);
+		ci.committedDigest = random.k12Id(random.indexedId(200000 + i));
+		random.invokeUserProcedure(0, 9, ci, co, miner, deposit);
+		ASSERT_TRUE(co.commitSuccessful);
+	}
+	EXPECT_EQ(random.contractInfo().activeCommitments, RANDOM_Capacity::maxCommitments);
+
+	// The next commit does not fit and its deposit goes back
+	id extra = random.indexedId(100000 + RANDOM_Capacity::maxCommitments);
+	random.increaseEnergy(extra, deposit);
+	ci.committedDigest = random.k12Id(random.indexedId(200000 + RANDOM_Capacity::maxCommitments));
+	random.invokeUserProcedure(0, 9, ci, co, extra, deposit);
+	EXPECT_FALSE(co.commitSuccessful);
+	EXPECT_EQ(getBalance(extra), (long long)deposit);
+	random.callFunction(0, 8, pi, po);
+	EXPECT_EQ(po.counters.commitsRejectedByCapacity, 1u);
+	EXPECT_EQ(random.contractInfo().activeCommitments, RANDOM_Capacity::maxCommitments);
+
+	// Revealing every commitment fills the recent miner list up to maxRecentMiners and no further
+	SET_TICK(12);
+	for (uint32 i = 0; i < RANDOM_Capacity::maxCommitments; ++i)
+	{
+		ri.revealedSeed = random.indexedId(200000 + i);
+		random.invokeUserProcedure(0, 10, ri, ro, random.indexedId(100000 + i), 0);
+		ASSERT_TRUE(ro.revealSuccessful);
+	}
+	EXPECT_EQ(random.contractInfo().activeCommitments, 0u);
+	EXPECT_EQ(random.contractInfo().recentMinerCount, RANDOM_Capacity::maxRecentMiners);
+}
+
+TEST(ContractRandom, RevealAndCommitBatchHandlesParallelFlows)
+{
+	ContractTestingRandom random;
+	id miner = random.testId(9201);
+	random.increaseEnergy(miner, 100000);
+	id seeds[3] = { random.testId(9211), random.testId(9212), random.testId(9213) };
+	id nextSeeds[3] = { random.testId(9221), random.testId(9222), random.testId(9223) };
+	EXPECT_EQ(sizeof(RANDOM::RevealAndCommitBatch_input), 544u); // EXTRA_DATA_SIZE_MINER_BATCH in the client
+
+	// Too many flows: rejected, and nothing to refund without a reward
+	system.tick = 100;
+	RANDOM::RevealAndCommitBatch_input inp{};
+	RANDOM::RevealAndCommitBatch_output out{};
+	RANDOM::GetPerfCounters_input pi{};
+	RANDOM::GetPerfCounters_output po{};
+	inp.flowCount = RANDOM_MAX_BATCH_FLOWS + 1;
+	random.invokeUserProcedure(0, 5, inp, out, miner, 0);
+	random.callFunction(0, 8, pi, po);
+	EXPECT_EQ(po.counters.refundsIssued, 0u);
+
+	// Early-epoch mode: nothing is committed and the deposits go back
+	inp.flowCount = 3;
+	for (int f = 0; f < 3; ++f)
+	{
+		inp.committedDigests.set(f, random.k12Id(seeds[f]));
+	}
+	SET_TICK_IS_EMPTY(true);
+	random.invokeUserProcedure(0, 5, inp, out, miner, 3000);
+	SET_TICK_IS_EMPTY(false);
+	EXPECT_EQ(out.committedCount, 0u);
+	EXPECT_EQ(getBalance(miner), 100000);
+	EXPECT_EQ(random.contractInfo().activeCommitments, 0);
+
+	// Three flows committed in one transaction, 1000 QU each
+	random.invokeUserProcedure(0, 5, inp, out, miner, 3000);
+	EXPECT_EQ(out.committedCount, 3u);
+	EXPECT_EQ(random.contractInfo().activeCommitments, 3);
+
+	// Reveal all three (one seed listed twice) and recommit; one pool version for the batch
+	system.tick = 105;
+	uint64 versionBefore = random.contractInfo().entropyPoolVersion;
+	long long balanceBefore = getBalance(miner);
+	inp.flowCount = 4;
+	for (int f = 0; f < 3; ++f)
+	{
+		inp.revealedSeeds.set(f, seeds[f]);
+		inp.committedDigests.set(f, random.k12Id(nextSeeds[f]));
+	}
+	inp.revealedSeeds.set(3, seeds[1]);
+	inp.committedDigests.set(3, id::zero());
+	random.invokeUserProcedure(0, 5, inp, out, miner, 3000);
+	random.callSystemProcedure(0, END_TICK);
+	EXPECT_EQ(out.revealedCount, 3u);
+	EXPECT_EQ(out.depositReturned, 3000u);
+	EXPECT_EQ(out.committedCount, 3u);
+	EXPECT_EQ(getBalance(miner), balanceBefore);
+	EXPECT_EQ(random.contractInfo().entropyPoolVersion, versionBefore + 1);
+	EXPECT_EQ(random.contractInfo().recentMinerCount, 1);
+	EXPECT_EQ(random.contractInfo().activeCommitments, 3);
+
+	// Past the deadline the sweep forfeits the flows; a reward that does not split into valid deposits is refunded
+	system.tick = 120;
+	random.callSystemProcedure(0, BEGIN_TICK);
+	balanceBefore = getBalance(miner);
+	inp.flowCount = 3;
+	for (int f = 0; f < 3; ++f)
+	{
+		inp.revealedSeeds.set(f, nextSeeds[f]);
+		inp.committedDigests.set(f, random.k12Id(seeds[f]));
+	}
+	random.invokeUserProcedure(0, 5, inp, out, miner, 2500);
+	EXPECT_EQ(out.revealedCount, 0u);
+	EXPECT_EQ(out.forfeitedCount, 0u);
+	EXPECT_EQ(out.committedCount, 0u);
+	EXPECT_EQ(getBalance(miner), balanceBefore);
+	EXPECT_EQ(random.contractInfo().activeCommitments, 0);
+	EXPECT_EQ(random.contractInfo().lostDepositsRevenue, 3000);
+}
+
+TEST(ContractRandom, PrepaidBuysDebitExactPriceAndNothingOnFailure)
+{
+	ContractTestingRandom random;
+	id miner = random.testId(9301);
+	id buyer = random.testId(9302);
+	random.increaseEnergy(buyer, 100000);
+
+	RANDOM::DepositPrepaid_input depIn{};
+	RANDOM::DepositPrepaid_output depOut{};
+	random.invokeUserProcedure(0, 6, depIn, depOut, buyer, 50000);
+	EXPECT_TRUE(depOut.success);
+	EXPECT_EQ(depOut.balance, 50000u);
+
+	RANDOM::GetPrepaidBalance_input balIn{};
+	RANDOM::GetPrepaidBalance_output balOut{};
+	balIn.buyerId = buyer;
+
+	// No eligible miner yet: the buy fails and neither debits nor transfers anything
+	RANDOM::BuyEntropy_input inp{};
+	RANDOM::BuyEntropy_output out{};
+	inp.numberOfBytes = 16;
+	inp.minMinerDeposit = 1000;
+	inp.usePrepaid = true;
+	random.invokeUserProcedure(0, 2, inp, out, buyer, 0);
+	EXPECT_FALSE(out.success);
+	random.callFunction(0, 5, balIn, balOut);
+	EXPECT_EQ(balOut.balance, 50000u);
+	EXPECT_EQ(getBalance(buyer), 50000);
+
+	// With a miner, each buy debits exactly the quoted price; an attached reward is credited first
+	random.commit(miner, random.testBits(93), 1000);
+	random.revealAndCommit(miner, random.testBits(93), random.testBits(94), 1000);
+	uint64 price = random.queryPrice(16, 1000);
+	random.invokeUserProcedure(0, 2, inp, out, buyer, 0);
+	EXPECT_TRUE(out.success);
+	random.invokeUserProcedure(0, 2, inp, out, buyer, 5000);
+	EXPECT_TRUE(out.success);
+	random.callFunction(0, 5, balIn, balOut);
+	EXPECT_EQ(balOut.balance, 55000 - 2 * price);
+	EXPECT_EQ(getBalance(buyer), 45000);
+
+	// Insufficient balance fails without a debit
+	RANDOM::BuyEntropyBulk_input bulkIn{};
+	RANDOM::BuyEntropyBulk_output bulkOut{};
+	bulkIn.numberOfBytes = RANDOM_BULK_RANDOMBYTES_LEN;
+	bulkIn.minMinerDeposit = 1000;
+	bulkIn.usePrepaid = true;
+	EXPECT_GT(random.queryPrice(RANDOM_BULK_RANDOMBYTES_LEN, 1000), 55000 - 2 * price);
+	random.invokeUserProcedure(0, 3, bulkIn, bulkOut, buyer, 0);
+	EXPECT_FALSE(bulkOut.success);
+	random.callFunction(0, 5, balIn, balOut);
+	EXPECT_EQ(balOut.balance, 55000 - 2 * price);
+
+	// Partial and full withdrawal; the emptied entry is dropped
+	RANDOM::WithdrawPrepaid_input wIn{};
+	RANDOM::WithdrawPrepaid_output wOut{};
+	wIn.amount = 1000;
+	random.invokeUserProcedure(0, 7, wIn, wOut, buyer, 0);
+	EXPECT_EQ(wOut.withdrawn, 1000u);
+	EXPECT_EQ(wOut.balance, 54000 - 2 * price);
+	wIn.amount = 0;
+	random.invokeUserProcedure(0, 7, wIn, wOut, buyer, 0);
+	EXPECT_EQ(wOut.withdrawn, 54000 - 2 * price);
+	EXPECT_EQ(wOut.balance, 0u);
+	EXPECT_EQ(getBalance(buyer), (long long)(100000 - 2 * price));
+	random.callFunction(0, 5, balIn, balOut);
+	EXPECT_EQ(balOut.balance, 0u);
+}
+
+TEST(ContractRandom, ZeroBytePrepaidBuyLeavesBalanceIndexIntact)
+{
+	ContractTestingRandom random;
+	id miner = random.testId(9311);
+	id holder = random.testId(9312);
+	id stranger = random.testId(9313);
+	id newcomer = random.testId(9314);
+	random.increaseEnergy(holder, 1000);
+	random.increaseEnergy(stranger, 1000);
+	random.increaseEnergy(newcomer, 1000);
+	random.commit(miner, random.testBits(95), 1000);
+	random.revealAndCommit(miner, random.testBits(95), random.testBits(96), 1000);
+
+	RANDOM::DepositPrepaid_input depIn{};
+	RANDOM::DepositPrepaid_output depOut{};
+	random.invokeUserProcedure(0, 6, depIn, depOut, holder, 500);
+	EXPECT_TRUE(depOut.success);
+
+	// Zero bytes cost nothing: the buy fails, with or without an attached amount, and touches no balance
+	RANDOM::BuyEntropy_input inp{};
+	RANDOM::BuyEntropy_output out{};
+	inp.numberOfBytes = 0;
+	inp.minMinerDeposit = 1000;
+	inp.usePrepaid = true;
+	random.invokeUserProcedure(0, 2, inp, out, stranger, 0);
+	EXPECT_FALSE(out.success);
+	random.invokeUserProcedure(0, 2, inp, out, stranger, 0);
+	EXPECT_FALSE(out.success);
+	random.invokeUserProcedure(0, 2, inp, out, stranger, 300);
+	EXPECT_FALSE(out.success);
+	EXPECT_EQ(getBalance(stranger), 1000);
+
+	RANDOM::GetPrepaidBalance_input balIn{};
+	RANDOM::GetPrepaidBalance_output balOut{};
+	balIn.buyerId = holder;
+	random.callFunction(0, 5, balIn, balOut);
+	EXPECT_EQ(balOut.balance, 500u);
+	balIn.buyerId = stranger;
+	random.callFunction(0, 5, balIn, balOut);
+	EXPECT_EQ(balOut.balance, 0u);
+
+	// The index still accepts new buyers
+	random.invokeUserProcedure(0, 6, depIn, depOut, newcomer, 700);
+	EXPECT_TRUE(depOut.success);
+	EXPECT_EQ(depOut.balance, 700u);
+}
+
+TEST(ContractRandom, RevealsOfOneTickShareOnePoolVersion)
+{
+	ContractTestingRandom random;
+	id miners[4] = { random.testId(9401), random.testId(9402), random.testId(9403), random.testId(9404) };
+	SET_TICK(200);
+	for (int m = 0; m < 4; ++m)
+	{
+		random.commit(miners[m], random.testBits(940 + m), 1000);
+	}
+	random.callSystemProcedure(0, END_TICK);
+	EXPECT_EQ(random.contractInfo().entropyPoolVersion, 0);
+
+	// Four reveals in tick 203 become one version, committed at the end of the tick
+	SET_TICK(203);
+	for (int m = 0; m < 4; ++m)
+	{
+		random.stopMining(miners[m], random.testBits(940 + m));
+	}
+	EXPECT_EQ(random.contractInfo().totalReveals, 4);
+	EXPECT_EQ(random.contractInfo().entropyPoolVersion, 0);
+	random.callSystemProcedure(0, END_TICK);
+	EXPECT_EQ(random.contractInfo().entropyPoolVersion, 1);
+
+	m256i expected = m256i::zero();
+	for (int m = 0; m < 4; ++m)
+	{
+		id digest = random.k12Digest(random.testBits(940 + m));
+		for (int lane = 0; lane < 4; ++lane)
+		{
+			expected.m256i_u64[lane] ^= digest.m256i_u64[lane];
+		}
+	}
+
+	// Ticks without reveals do not add versions; version 1 is replayable once it is older than the buy version
+	SET_TICK(204);
+	random.callSystemProcedure(0, END_TICK);
+	EXPECT_EQ(random.contractInfo().entropyPoolVersion, 1);
+	for (int m = 0; m < 3; ++m)
+	{
+		SET_TICK(205 + m);
+		random.commit(miners[m], random.testBits(950 + m), 1000);
+		random.stopMining(miners[m], random.testBits(950 + m));
+		random.callSystemProcedure(0, END_TICK);
+	}
+	EXPECT_EQ(random.contractInfo().entropyPoolVersion, 4);
+
+	RANDOM::GetEntropyAtVersion_input gi{};
+	RANDOM::GetEntropyAtVersion_output go{};
+	gi.entropyVersion = 1;
+	random.callFunction(0, 4, gi, go);
+	ASSERT_TRUE(go.found);
+	EXPECT_EQ(go.tick, 203u);
+	EXPECT_EQ(go.entropyPool, expected);
+}
+
+TEST(ContractRandom, QueryPriceMatrixMatchesQueryPrice)
+{
+	ContractTestingRandom random;
+	RANDOM::QueryPriceMatrix_input mi{};
+	RANDOM::QueryPriceMatrix_output mo{};
+	random.callFunction(0, 6, mi, mo);
+	for (uint32 numberOfBytes = 1; numberOfBytes <= RANDOM_RANDOMBYTES_LEN; ++numberOfBytes)
+	{
+		for (uint32 tier = 0; tier < RANDOM_VALID_DEPOSIT_AMOUNTS; ++tier)
+		{
+			EXPECT_EQ(mo.prices.get((numberOfBytes - 1) * RANDOM_VALID_DEPOSIT_AMOUNTS + tier),
+				random.queryPrice(numberOfBytes, mo.validDepositAmounts.get(tier)));
+		}
+	}
+	EXPECT_EQ(mo.validDepositAmounts.get(3), 1000u);
+}
+
+TEST(ContractRandom, GetAvailableSecurityPredictsBuyOutcome)
+{
+	ContractTestingRandom random;
+	id miner = random.testId(9501);
+	id buyer = random.testId(9502);
+	RANDOM::GetAvailableSecurity_input si{};
+	RANDOM::GetAvailableSecurity_output so{};
+
+	random.callFunction(0, 7, si, so);
+	for (uint32 tier = 0; tier < RANDOM_VALID_DEPOSIT_AMOUNTS; ++tier)
+	{
+		EXPECT_FALSE(so.available.get(tier));
+	}
+
+	// A 1000 QU reveal at tick 50 covers tiers 0..3 until it goes stale
+	SET_TICK(45);
+	random.commit(miner, random.testBits(95), 1000);
+	SET_TICK(50);
+	random.revealAndCommit(miner, random.testBits(95), random.testBits(96), 1000);
+	random.callFunction(0, 7, si, so);
+	const uint32 staleAt = so.staleAtTick.get(0);
+	for (uint32 tier = 0; tier < RANDOM_VALID_DEPOSIT_AMOUNTS; ++tier)
+	{
+		EXPECT_EQ(so.available.get(tier), tier <= 3);
+		EXPECT_EQ(so.revealerDeposit.get(tier), tier <= 3 ? 1000u : 0u);
+	}
+	EXPECT_EQ(so.staleAtTick.get(3), staleAt);
+	EXPECT_TRUE(random.buyEntropy(buyer, 8, so.validDepositAmounts.get(3), random.queryPrice(8, 1000), true));
+	EXPECT_FALSE(random.buyEntropy(buyer, 8, so.validDepositAmounts.get(4), random.queryPrice(8, 10000), false));
+
+	SET_TICK(staleAt - 1);
+	random.callFunction(0, 7, si, so);
+	EXPECT_TRUE(so.available.get(3));
+	EXPECT_TRUE(random.buyEntropy(buyer, 8, 1000, random.queryPrice(8, 1000), true));
+
+	SET_TICK(staleAt);
+	random.callFunction(0, 7, si, so);
+	EXPECT_FALSE(so.available.get(3));
+	EXPECT_FALSE(random.buyEntropy(buyer, 8, 1000, random.queryPrice(8, 1000), false));
+}
+
+TEST(ContractRandom, PerfCountersTrackHotLoops)
+{
+	ContractTestingRandom random;
+	id miner = random.testId(9601);
+	id buyer = random.testId(9602);
+	RANDOM::GetPerfCounters_input pi{};
+	RANDOM::GetPerfCounters_output po{};
+
+	// Every RevealAndCommit walks the owner list: 0 + 1 + 2 entries for the commits, 3 for the reveal
+	SET_TICK(10);
+	random.commit(miner, random.testBits(961), 100);
+	random.commit(miner, random.testBits(962), 100);
+	random.commit(miner, random.testBits(963), 100);
+	random.revealAndCommit(miner, random.testBits(961), random.testBits(964), 100);
+	random.callFunction(0, 8, pi, po);
+	EXPECT_EQ(po.counters.revealMatchIterations, 3u + 3u);
+	EXPECT_EQ(po.counters.recentMinerLookups, 1u);
+	EXPECT_EQ(po.activeCommitments, 3u);
+	EXPECT_EQ(po.recentMinerCount, 1u);
+
+	// A failed buy refunds once; the sweep after the deadline visits the three expiring commitments
+	random.buyEntropy(buyer, 8, 1000000, 100, false);
+	SET_TICK(30);
+	random.callSystemProcedure(0, BEGIN_TICK);
+	random.buyEntropy(buyer, 8, 1000000, 100, false);
+	random.callFunction(0, 8, pi, po);
+	EXPECT_EQ(po.counters.refundsIssued, 2u);
+	EXPECT_EQ(po.counters.sweepEntriesScanned, 3u);
+	EXPECT_EQ(po.counters.maxSweepEntriesScanned, 3u);
+	EXPECT_EQ(po.activeCommitments, 0u);
+	EXPECT_EQ(po.counters.commitsRejectedByCapacity, 0u);
+}
+
+TEST(ContractRandom, FullCapacityKeepsPerCallWorkBounded)
+{
+	ContractTestingRandom random;
+	const uint32 commitments = RANDOM_MAX_COMMITMENTS;
+	const uint32 recentMiners = RANDOM_MAX_RECENT_MINERS;
+	RANDOM::GetPerfCounters_input pi{};
+	RANDOM::GetPerfCounters_output before{}, after{};
+
+	// Fill commitment storage (one commitment per miner), then reveal and recommit with the first
+	// recentMiners of them so that both structures are full at the same time
+	SET_TICK(10);
+	for (uint32 i = 0; i < commitments; ++i)
+	{
+		random.commit(random.indexedId(40000 + i), random.testBits(40000 + i), 100);
+	}
+	SET_TICK(12);
+	for (uint32 i = 0; i < recentMiners; ++i)
+	{
+		random.revealAndCommit(random.indexedId(40000 + i), random.testBits(40000 + i), random.testBits(80000 + i), 100);
+	}
+	random.callSystemProcedure(0, END_TICK);
+	EXPECT_EQ(random.contractInfo().activeCommitments, commitments);
+	EXPECT_EQ(random.contractInfo().recentMinerCount, recentMiners);
+
+	// A commit beyond capacity is refunded instead of keeping the deposit
+	id extra = random.indexedId(39999);
+	random.increaseEnergy(extra, 100);
+	RANDOM::RevealAndCommit_input inp{};
+	RANDOM::RevealAndCommit_output out{};
+	inp.committedDigest = random.k12Digest(random.testBits(39999));
+	random.invokeUserProcedure(0, 1, inp, out, extra, 100);
+	EXPECT_FALSE(out.commitSuccessful);
+	EXPECT_EQ(getBalance(extra), 100);
+	random.callFunction(0, 8, pi, before);
+	EXPECT_EQ(before.counters.commitsRejectedByCapacity, 1u);
+
+	// Evicting a recent miner at full capacity (the newcomer ranks higher through its newer pool
+	// version): one owner-list entry, O(log n) heap work, no sweep
+	SET_TICK(13);
+	id evictor = random.indexedId(40000 + recentMiners);
+	random.revealAndCommit(evictor, random.testBits(40000 + recentMiners), random.testBits(39998), 100);
+	random.callFunction(0, 8, pi, after);
+	uint64 heapDepth = 0;
+	while ((1ULL << heapDepth) < recentMiners)
+	{
+		++heapDepth;
+	}
+	EXPECT_EQ(after.counters.revealMatchIterations - before.counters.revealMatchIterations, 1u);
+	EXPECT_LE(after.counters.recentMinerSiftSteps - before.counters.recentMinerSiftSteps, heapDepth);
+	EXPECT_EQ(after.counters.recentMinerEvictions - before.counters.recentMinerEvictions, 1u);
+	EXPECT_EQ(after.counters.sweepEntriesScanned - before.counters.sweepEntriesScanned, 0u);
+	EXPECT_EQ(after.recentMinerCount, recentMiners);
+
+	// A buy at full capacity does a fixed amount of work
+	before = after;
+	EXPECT_TRUE(random.buyEntropy(random.indexedId(39997), 32, 100, random.queryPrice(32, 100), true));
+	random.callFunction(0, 8, pi, after);
+	EXPECT_EQ(after.counters.sweepEntriesScanned, before.counters.sweepEntriesScanned);
+	EXPECT_EQ(after.counters.revealMatchIterations, before.counters.revealMatchIterations);
+	EXPECT_EQ(after.counters.recentMinerSiftSteps, before.counters.recentMinerSiftSteps);
+}
+
+TEST(ContractRandom, SnapshotPagesCoverAllEntriesAtOneStateVersion)
+{
+	ContractTestingRandom random;
+	const uint32 miners = 3 * RANDOM_SNAPSHOT_PAGE_LEN / 2;
+	SET_TICK(10);
+	for (uint32 i = 0; i < miners; ++i)
+	{
+		random.commit(random.indexedId(500 + i), random.testBits(500 + i), 10);
+	}
+	SET_TICK(12);
+	for (uint32 i = 0; i < miners / 2; ++i)
+	{
+		random.revealAndCommit(random.indexedId(500 + i), random.testBits(500 + i), random.testBits(900 + i), 10);
+	}
+	const uint32 recentMiners = (miners / 2 < RANDOM_MAX_RECENT_MINERS) ? miners / 2 : RANDOM_MAX_RECENT_MINERS;
+
+	// Commitments: dense pages in slot order, every owner seen exactly once
+	RANDOM::GetCommitmentsPage_input ci{};
+	RANDOM::GetCommitmentsPage_output co{};
+	uint64 commitmentsSeen = 0, amountSeen = 0, version = 0;
+	uint32 pages = 0;
+	do
+	{
+		random.callFunction(0, 9, ci, co);
+		if (pages == 0)
+		{
+			version = co.stateVersion;
+		}
+		EXPECT_EQ(co.stateVersion, version);
+		EXPECT_EQ(co.totalCount, miners);
+		EXPECT_LE(co.count, RANDOM_SNAPSHOT_PAGE_LEN);
+		for (uint32 i = 0; i < co.count; ++i)
+		{
+			RANDOM_CommitmentRecord record = co.commitments.get(i);
+			EXPECT_EQ(record.revealDeadlineTick, record.commitTick + random.contractInfo().revealTimeoutTicks);
+			amountSeen += record.amount;
+		}
+		commitmentsSeen += co.count;
+		ci.cursor = co.nextCursor;
+		pages++;
+	} while (ci.cursor != 0);
+	EXPECT_EQ(commitmentsSeen, miners);
+	EXPECT_EQ(amountSeen, 10ULL * miners);
+	EXPECT_EQ(pages, (miners + RANDOM_SNAPSHOT_PAGE_LEN - 1) / RANDOM_SNAPSHOT_PAGE_LEN);
+
+	// Recent miners: only occupied slots are returned
+	RANDOM::GetRecentMinersPage_input mi{};
+	RANDOM::GetRecentMinersPage_output mo{};
+	uint64 minersSeen = 0;
+	do
+	{
+		random.callFunction(0, 10, mi, mo);
+		EXPECT_EQ(mo.stateVersion, version);
+		EXPECT_EQ(mo.recentMinerCount, recentMiners);
+		for (uint32 i = 0; i < mo.count; ++i)
+		{
+			EXPECT_EQ(mo.miners.get(i).depositTier, 1u);
+			EXPECT_EQ(mo.miners.get(i).lastRevealTick, 12u);
+		}
+		minersSeen += mo.count;
+		mi.cursor = mo.nextCursor;
+	} while (mi.cursor != 0);
+	EXPECT_EQ(minersSeen, recentMiners);
+
+	// Any mutation of either structure moves the version
+	random.commit(random.indexedId(499), random.testBits(499), 10);
+	ci.cursor = 0;
+	random.callFunction(0, 9, ci, co);
+	EXPECT_GT(co.stateVersion, version);
+	version = co.stateVersion;
+	EXPECT_EQ(random.claimEarnings(random.indexedId(500)), 0u);
+	mi.cursor = 0;
+	random.callFunction(0, 10, mi, mo);
+	EXPECT_GT(mo.stateVersion, version);
+
+	// Read-only calls leave it alone
+	version = mo.stateVersion;
+	random.callFunction(0, 10, mi, mo);
+	EXPECT_EQ(mo.stateVersion, version);
+}
+
+TEST(ContractRandom, EventRingRecordsEachOutcomeInOrder)
+{
+	ContractTestingRandom random;
+	RANDOM::GetEventsSince_input ei{};
+	RANDOM::GetEventsSince_output eo{};
+	id revealer = random.testId(71), forfeiter = random.testId(72), refunded = random.testId(73), buyer = random.testId(74);
+
+	SET_TICK(10);
+	random.commit(revealer, random.testBits(71), 100);
+	random.commit(forfeiter, random.testBits(72), 10);
+	SET_TICK(11);
+	random.commit(refunded, random.testBits(73), 1000);
+	random.callFunction(0, 11, ei, eo);
+	EXPECT_EQ(eo.count, 0u); // commits alone are not events
+
+	SET_TICK(12);
+	random.revealAndCommit(revealer, random.testBits(71), random.testBits(171), 100);
+	random.callSystemProcedure(0, END_TICK);
+	SET_TICK(13);
+	random.callSystemProcedure(0, END_TICK);
+	SET_TICK(14);
+	random.callSystemProcedure(0, END_TICK);
+	EXPECT_TRUE(random.buyEntropy(buyer, 8, 100, random.queryPrice(8, 100), true));
+
+	// The forfeiter's deadline (19) passes; the refunded miner's deadline tick (20) is empty
+	SET_TICK(20);
+	SET_TICK_IS_EMPTY(true);
+	random.callSystemProcedure(0, BEGIN_TICK);
+	SET_TICK_IS_EMPTY(false);
+
+	random.callFunction(0, 11, ei, eo);
+	ASSERT_EQ(eo.count, 4u);
+	EXPECT_FALSE(eo.missedEvents);
+	EXPECT_EQ(eo.oldestSeq, 0u);
+	EXPECT_EQ(eo.nextSeq, 4u);
+	const uint8 expectedTypes[4] = { RANDOM_EVENT_REVEAL, RANDOM_EVENT_PURCHASE, RANDOM_EVENT_EMPTY_TICK_REFUND, RANDOM_EVENT_FORFEIT };
+	const id expectedSubjects[4] = { revealer, buyer, refunded, forfeiter };
+	const uint64 expectedAmounts[4] = { 100, random.queryPrice(8, 100), 1000, 10 };
+	for (uint32 i = 0; i < 4; ++i)
+	{
+		EXPECT_EQ(eo.events.get(i).seq, i);
+		EXPECT_EQ(eo.events.get(i).type, expectedTypes[i]);
+		EXPECT_EQ(eo.events.get(i).subject, expectedSubjects[i]);
+		EXPECT_EQ(eo.events.get(i).amount, expectedAmounts[i]);
+	}
+	EXPECT_EQ(eo.events.get(0).tick, 12u);
+	EXPECT_EQ(eo.events.get(3).tick, 20u);
+
+	// Tailing from nextSeq returns nothing until something happens
+	ei.seq = eo.nextSeq;
+	random.callFunction(0, 11, ei, eo);
+	EXPECT_EQ(eo.count, 0u);
+	EXPECT_EQ(eo.nextSeq, 4u);
+
+	// Once the ring wraps, a reader that fell behind is told so and resumes at the oldest kept event
+	SET_TICK(21);
+	random.revealAndCommit(revealer, random.testBits(171), random.testBits(271), 100);
+	for (uint32 i = 0; i < RANDOM_EVENT_RING_LEN; ++i)
+	{
+		EXPECT_TRUE(random.buyEntropy(buyer, 1, 1, random.queryPrice(1, 1), true));
+	}
+	ei.seq = 4;
+	random.callFunction(0, 11, ei, eo);
+	EXPECT_TRUE(eo.missedEvents);
+	EXPECT_EQ(eo.oldestSeq, 5u);
+	EXPECT_EQ(eo.count, RANDOM_EVENT_PAGE_LEN);
+	EXPECT_EQ(eo.events.get(0).seq, 5u);
+	EXPECT_EQ(eo.nextSeq, 5u + RANDOM_EVENT_PAGE_LEN);
+}
+
+TEST(ContractRandom, DepositTiersValidateAndGateEligibility)
+{
+	ContractTestingRandom random;
+
+	// Exactly the powers of ten from 1 to 10^15 are valid deposits
+	EXPECT_EQ(RANDOM_DepositTiers::floorTier(0), 0u);
+	EXPECT_EQ(RANDOM_DepositTiers::floorTier(9), 0u);
+	EXPECT_EQ(RANDOM_DepositTiers::floorTier(10), 1u);
+	EXPECT_EQ(RANDOM_DepositTiers::floorTier(0xFFFFFFFFFFFFFFFFULL), RANDOM_VALID_DEPOSIT_AMOUNTS - 1);
+	const uint64 deposits[] = { 0, 1, 9, 10, 11, 100, 1000000000000000ULL, 1000000000000001ULL, 10000000000000000ULL };
+	const bool valid[] = { false, true, false, true, false, true, true, false, false };
+	SET_TICK(10);
+	for (uint32 i = 0; i < 9; ++i)
+	{
+		id miner = random.indexedId(7000 + i);
+		random.increaseEnergy(miner, deposits[i] + 1);
+		RANDOM::RevealAndCommit_input inp{};
+		RANDOM::RevealAndCommit_output out{};
+		inp.committedDigest = random.k12Digest(random.testBits(7000 + i));
+		random.invokeUserProcedure(0, 1, inp, out, miner, deposits[i]);
+		EXPECT_EQ(out.commitSuccessful, valid[i]) << deposits[i];
+	}
+	EXPECT_EQ(random.contractInfo().activeCommitments, 4u);
+
+	// A revealed 100 QU deposit covers requirements up to 100 and reports its amount
+	SET_TICK(12);
+	random.increaseEnergy(random.indexedId(7005), 100);
+	random.revealAndCommit(random.indexedId(7005), random.testBits(7005), random.testBits(7100), 100);
+	random.callSystemProcedure(0, END_TICK);
+	SET_TICK(13);
+	random.callSystemProcedure(0, END_TICK);
+	SET_TICK(14);
+	random.callSystemProcedure(0, END_TICK);
+	RANDOM::BuyEntropy_input bi{};
+	RANDOM::BuyEntropy_output bo{};
+	bi.numberOfBytes = 4;
+	for (uint64 requirement : { 0ULL, 1ULL, 11ULL, 100ULL })
+	{
+		bi.minMinerDeposit = requirement;
+		random.increaseEnergy(random.testId(7200), random.queryPrice(4, requirement));
+		random.invokeUserProcedure(0, 2, bi, bo, random.testId(7200), random.queryPrice(4, requirement));
+		EXPECT_TRUE(bo.success) << requirement;
+		EXPECT_EQ(bo.usedMinerDeposit, 100u);
+	}
+	EXPECT_FALSE(random.buyEntropy(random.testId(7201), 4, 101, random.queryPrice(4, 101), false));
+	EXPECT_FALSE(random.buyEntropy(random.testId(7201), 4, 10000000000000001ULL, random.queryPrice(4, 10000000000000001ULL), false));
+}
+
+TEST(ContractRandom, RevealDigestOnlyComputedWithPendingCommitment)
+{
+	ContractTestingRandom random;
+	RANDOM::GetPerfCounters_input pi{};
+	RANDOM::GetPerfCounters_output po{};
+	id miner = random.testId(81);
+
+	// Starting a flow: no pending commitment, no hash
+	SET_TICK(10);
+	random.commit(miner, random.testBits(81), 10);
+	random.callFunction(0, 8, pi, po);
+	EXPECT_EQ(po.counters.revealDigestsComputed, 0u);
+	EXPECT_EQ(po.activeCommitments, 1u);
+
+	// Reveal + commit and stop: one hash each
+	SET_TICK(12);
+	random.revealAndCommit(miner, random.testBits(81), random.testBits(82), 10);
+	random.stopMining(miner, random.testBits(82));
+	random.callFunction(0, 8, pi, po);
+	EXPECT_EQ(po.counters.revealDigestsComputed, 2u);
+	EXPECT_EQ(po.activeCommitments, 0u);
+	EXPECT_EQ(random.contractInfo().totalReveals, 2u);
+
+	// Restarting the flow, and a stray stop call without anything pending, skip the hash again
+	random.stopMining(miner, random.testBits(83));
+	random.commit(miner, random.testBits(84), 10);
+	random.callFunction(0, 8, pi, po);
+	EXPECT_EQ(po.counters.revealDigestsComputed, 2u);
+	EXPECT_EQ(po.activeCommitments, 1u);
+
+	// A wrong preimage with a pending commitment is hashed but matches nothing
+	random.stopMining(miner, random.testBits(85));
+	random.callFunction(0, 8, pi, po);
+	EXPECT_EQ(po.counters.revealDigestsComputed, 3u);
+	EXPECT_EQ(po.activeCommitments, 1u);
+}
+
+TEST(ContractRandom, RevealAndCommitCompactUsesSeedPreimages)
+{
+	ContractTestingRandom random;
+	EXPECT_EQ(sizeof(RANDOM::RevealAndCommitCompact_input), 64u);
+	id miner = random.testId(91);
+	id seed1 = random.testId(191), seed2 = random.testId(192);
+	random.increaseEnergy(miner, 1000);
+	RANDOM::RevealAndCommitCompact_input inp{};
+	RANDOM::RevealAndCommitCompact_output out{};
+
+	// Start a flow: nothing to reveal
+	SET_TICK(10);
+	inp.committedDigest = random.k12Id(seed1);
+	random.invokeUserProcedure(0, 8, inp, out, miner, 100);
+	EXPECT_FALSE(out.revealSuccessful);
+	EXPECT_TRUE(out.commitSuccessful);
+
+	// Reveal the seed and recommit: K12(seed) goes into the pool
+	SET_TICK(12);
+	inp.revealedSeed = seed1;
+	inp.committedDigest = random.k12Id(seed2);
+	random.invokeUserProcedure(0, 8, inp, out, miner, 100);
+	EXPECT_TRUE(out.revealSuccessful);
+	EXPECT_TRUE(out.commitSuccessful);
+	EXPECT_EQ(out.depositReturned, 100u);
+	random.callSystemProcedure(0, END_TICK);
+
+	// Three more versions from another miner, so that version 1 becomes readable
+	id other = random.testId(93);
+	random.commit(other, random.testBits(1000), 10);
+	for (uint32 v = 0; v < 3; ++v)
+	{
+		SET_TICK(13 + v);
+		random.increaseEnergy(other, 10);
+		random.revealAndCommit(other, random.testBits(1000 + v), random.testBits(1001 + v), 10);
+		random.callSystemProcedure(0, END_TICK);
+	}
+	RANDOM::GetEntropyAtVersion_input gi{};
+	RANDOM::GetEntropyAtVersion_output go{};
+	gi.entropyVersion = 1;
+	random.callFunction(0, 4, gi, go);
+	EXPECT_TRUE(go.found);
+	EXPECT_EQ(go.entropyPool, random.k12Id(seed1));
+
+	// Revealing an already opened seed matches nothing and leaves the pending commitment alone
+	inp.revealedSeed = seed1;
+	inp.committedDigest = id::zero();
+	random.invokeUserProcedure(0, 8, inp, out, miner, 0);
+	EXPECT_FALSE(out.revealSuccessful);
+	EXPECT_EQ(random.contractInfo().activeCommitments, 2u);
+
+	// Stop: reveal seed2 with no new commitment; an amount sent along is refunded
+	inp.revealedSeed = seed2;
+	random.invokeUserProcedure(0, 8, inp, out, miner, 7);
+	EXPECT_TRUE(out.revealSuccessful);
+	EXPECT_FALSE(out.commitSuccessful);
+	EXPECT_EQ(random.contractInfo().activeCommitments, 1u);
+	EXPECT_EQ(getBalance(miner), 1000);
+
+	// Deposits that are not a valid tier, or below the minimum, are refunded
+	inp.revealedSeed = id::zero();
+	inp.committedDigest = random.k12Id(random.testId(196));
+	random.invokeUserProcedure(0, 8, inp, out, miner, 5);
+	EXPECT_FALSE(out.commitSuccessful);
+	EXPECT_EQ(getBalance(miner), 1000);
+	random.invokeUserProcedure(0, 8, inp, out, miner, 0);
+	EXPECT_FALSE(out.commitSuccessful);
+	EXPECT_EQ(getBalance(miner), 1000);
+	EXPECT_EQ(random.contractInfo().activeCommitments, 1u);
+}
+
+TEST(ContractRandom, RevealOpensOneCommitmentPerCall)
+{
+	ContractTestingRandom random;
+	id miner = random.testId(96);
+	id seed = random.testId(196);
+	random.increaseEnergy(miner, 200);
+	RANDOM::Commit_input ci{};
+	RANDOM::Commit_output co{};
+	RANDOM::Reveal_input ri{};
+	RANDOM::Reveal_output ro{};
+
+	// Two pending commitments to the same digest
+	SET_TICK(10);
+	ci.committedDigest = random.k12Id(seed);
+	random.invokeUserProcedure(0, 9, ci, co, miner, 100);
+	random.invokeUserProcedure(0, 9, ci, co, miner, 100);
+	EXPECT_EQ(random.contractInfo().activeCommitments, 2u);
+
+	// Each reveal opens one of them and returns one deposit
+	SET_TICK(12);
+	ri.revealedSeed = seed;
+	random.invokeUserProcedure(0, 10, ri, ro, miner, 0);
+	EXPECT_TRUE(ro.revealSuccessful);
+	EXPECT_EQ(ro.depositReturned, 100u);
+	EXPECT_EQ(random.contractInfo().activeCommitments, 1u);
+	EXPECT_EQ(random.contractInfo().totalSecurityDepositsLocked, 100u);
+	random.invokeUserProcedure(0, 10, ri, ro, miner, 0);
+	EXPECT_TRUE(ro.revealSuccessful);
+	EXPECT_EQ(random.contractInfo().activeCommitments, 0u);
+	EXPECT_EQ(getBalance(miner), 200);
+}
+
+TEST(ContractRandom, SeparateCommitAndRevealRunOneHalfEach)
+{
+	ContractTestingRandom random;
+	EXPECT_EQ(sizeof(RANDOM::Commit_input), 32u);
+	EXPECT_EQ(sizeof(RANDOM::Reveal_input), 32u);
+	id miner = random.testId(95);
+	id seed = random.testId(195);
+	random.increaseEnergy(miner, 1000);
+	RANDOM::Commit_input ci{};
+	RANDOM::Commit_output co{};
+	RANDOM::Reveal_input ri{};
+	RANDOM::Reveal_output ro{};
+	RANDOM::GetPerfCounters_input pi{};
+	RANDOM::GetPerfCounters_output po{};
+
+	// Rejected commits are refunded
+	SET_TICK(10);
+	random.invokeUserProcedure(0, 9, ci, co, miner, 100);
+	EXPECT_FALSE(co.commitSuccessful);
+	ci.committedDigest = random.k12Id(seed);
+	random.invokeUserProcedure(0, 9, ci, co, miner, 50);
+	EXPECT_FALSE(co.commitSuccessful);
+	EXPECT_EQ(getBalance(miner), 1000);
+
+	// A commit neither walks the reveal match nor hashes
+	random.invokeUserProcedure(0, 9, ci, co, miner, 100);
+	EXPECT_TRUE(co.commitSuccessful);
+	EXPECT_EQ(getBalance(miner), 900);
+	random.callFunction(0, 8, pi, po);
+	EXPECT_EQ(po.counters.revealDigestsComputed, 0u);
+	EXPECT_EQ(po.counters.revealMatchIterations, 0u);
+
+	// Reveal returns the deposit and any attached amount, and commits nothing
+	SET_TICK(12);
+	ri.revealedSeed = seed;
+	random.invokeUserProcedure(0, 10, ri, ro, miner, 5);
+	EXPECT_TRUE(ro.revealSuccessful);
+	EXPECT_EQ(ro.depositReturned, 100u);
+	EXPECT_EQ(getBalance(miner), 1000);
+	EXPECT_EQ(random.contractInfo().activeCommitments, 0u);
+	EXPECT_EQ(random.contractInfo().totalReveals, 1u);
+
+	// Nothing pending: no hash
+	random.invokeUserProcedure(0, 10, ri, ro, miner, 0);
+	EXPECT_FALSE(ro.revealSuccessful);
+	random.callFunction(0, 8, pi, po);
+	EXPECT_EQ(po.counters.revealDigestsComputed, 1u);
+}